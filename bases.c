@@ -0,0 +1,319 @@
+#include "headers.h"
+
+#define COMMENT '#'
+#define EXTENDED_CHARACTER '+'
+#define IMMEDIATE_CHARACTER '#'
+#define INDIRECT_CHARACTER '@'
+#define INITIAL_REGION_CAPACITY 8
+#define JUMP_CHARACTER 'J'
+
+int compareLabels(const void* first, const void* second);
+void displayBaseRegions(FILE* file, baseRegion* regions, int regionCount, referenceTable* table, int missCount, int coveredCount, int inserted);
+int findLabel(labeledLine* labels, int count, char* name);
+int insertBaseLoads(baseRegion* regions, int regionCount, referenceTable* table, sourceLines* source);
+void traceStatementFlow(sourceLines* source, statementFlow* flow);
+
+// Looks at every Format 3 reference of the control section that misses the PC-relative range
+// and groups them, in source order, into the fewest regions that a single base value can
+// reach. Each region is reported along with the symbol to use as its base. When requested,
+// LDB/BASE pairs are inserted where control enters each region.
+// Returns the number of LDB/BASE pairs inserted into the source lines
+int analyzeBases(controlSection* section, options* settings)
+{
+	referenceTable* table = &section->references;
+	sourceLines* source = &section->source;
+	symbol** symbolTable = section->symbols;
+	address* addresses = &section->addresses;
+	baseRegion* regions = NULL;
+	int regionCount = 0, regionCapacity = 0;
+	int missCount = 0, coveredCount = 0;
+	int inserted = 0;
+	bool needed = false;
+
+	for (int x = 0; x < table->count; x++)
+	{
+		reference* entry = &table->references[x];
+		symbol* target = entry->numeric ? NULL : findSymbol(symbolTable, entry->symbol);
+		symbol* base;
+		int pcRelative, baseValue;
+		bool covered;
+
+		if (target == NULL)
+		{
+			continue;
+		}
+		pcRelative = target->address - (entry->address + 3);
+		if (pcRelative >= PC_MIN_RANGE && pcRelative <= PC_MAX_RANGE)
+		{
+			continue;
+		}
+
+		// Test whether the BASE already in effect reaches the operand
+		if (strlen(entry->base) == 0)
+		{
+			baseValue = addresses->base;
+		}
+		else
+		{
+			base = findSymbol(symbolTable, entry->base);
+			baseValue = base != NULL ? base->address : -1;
+		}
+		covered = baseValue >= 0 && target->address - baseValue >= 0 && target->address - baseValue <= BASE_MAX_RANGE;
+		missCount++;
+		coveredCount += covered;
+
+		// Extend the current region while one base value still reaches every operand in it
+		if (regionCount > 0 &&
+			(target->address > regions[regionCount - 1].highTarget ? target->address : regions[regionCount - 1].highTarget) -
+			(target->address < regions[regionCount - 1].lowTarget ? target->address : regions[regionCount - 1].lowTarget) <= BASE_MAX_RANGE)
+		{
+			baseRegion* region = &regions[regionCount - 1];
+			if (target->address < region->lowTarget)
+			{
+				region->lowTarget = target->address;
+				strcpy(region->base, target->name);
+			}
+			if (target->address > region->highTarget)
+			{
+				region->highTarget = target->address;
+			}
+			region->lastReference = x;
+			region->missCount++;
+			region->coveredCount += covered;
+			continue;
+		}
+
+		if (regionCount == regionCapacity)
+		{
+			regionCapacity = regionCapacity > 0 ? regionCapacity * 2 : INITIAL_REGION_CAPACITY;
+			regions = resizeMemory(regions, sizeof(baseRegion) * regionCapacity);
+		}
+		regions[regionCount].firstReference = x;
+		regions[regionCount].lastReference = x;
+		regions[regionCount].lowTarget = target->address;
+		regions[regionCount].highTarget = target->address;
+		regions[regionCount].missCount = 1;
+		regions[regionCount].coveredCount = covered;
+		regions[regionCount].loadCount = 0;
+		strcpy(regions[regionCount].base, target->name);
+		regionCount++;
+	}
+
+	if (settings->insertBases)
+	{
+		// Once one region needs a base, every region loads its own: a branch from an inserted
+		// region could otherwise arrive in code that relies on a BASE directive of the source
+		for (int x = 0; x < regionCount; x++)
+		{
+			needed |= regions[x].coveredCount < regions[x].missCount;
+		}
+		if (needed)
+		{
+			inserted = insertBaseLoads(regions, regionCount, table, source);
+		}
+	}
+	displayBaseRegions(section->fileReport, regions, regionCount, table, missCount, coveredCount, inserted);
+
+	releaseMemory(regions);
+	return inserted;
+}
+
+// Orders labeled lines by name for qsort() and bsearch()
+int compareLabels(const void* first, const void* second)
+{
+	return strcmp(((labeledLine*)first)->name, ((labeledLine*)second)->name);
+}
+
+// Prints the suggested BASE regions to the provided report, with the LDB/BASE pairs inserted
+// for each region when there are any
+void displayBaseRegions(FILE* file, baseRegion* regions, int regionCount, referenceTable* table, int missCount, int coveredCount, int inserted)
+{
+	fprintf(file, "\nBASE Analysis: %d of %d Format 3 References Outside PC-Relative Range (%d Reached by Existing BASE)\n", missCount, table->count, coveredCount);
+	if (regionCount == 0)
+	{
+		return;
+	}
+	fprintf(file, "%-6s  %-6s  %-6s  %-6s  %-7s  %-10s  %-5s  %-8s\n", "Region", "Start", "End", "Base", "Address", "References", "Loads", "Action");
+	fprintf(file, "%-6s  %-6s  %-6s  %-6s  %-7s  %-10s  %-5s  %-8s\n", "------", "------", "------", "------", "-------", "----------", "-----", "--------");
+	for (int x = 0; x < regionCount; x++)
+	{
+		fprintf(file, "%6d  0x%-4X  0x%-4X  %-6s  0x%-5X  %10d  %5d  %s\n", x + 1,
+			table->references[regions[x].firstReference].address, table->references[regions[x].lastReference].address,
+			regions[x].base, regions[x].lowTarget, regions[x].missCount, regions[x].loadCount,
+			inserted > 0 ? "Inserted" : "Suggest");
+	}
+}
+
+// Returns the line of the statement with the provided label; otherwise, -1
+int findLabel(labeledLine* labels, int count, char* name)
+{
+	labeledLine key;
+	labeledLine* found;
+
+	snprintf(key.name, NAME_SIZE, "%.*s", NAME_SIZE - 1, name);
+	found = bsearch(&key, labels, count, sizeof(labeledLine), compareLabels);
+	return found != NULL ? found->line : -1;
+}
+
+// Inserts an LDB/BASE pair at every statement where control can enter a region with another
+// value in register B: the top of the region, and any statement inside it that is a subroutine
+// entry, follows a call or a change of base, or is the target of a jump from outside the
+// region. The top is moved up from the first reference over the instructions that fall through
+// into it, so a loop around the references loads the base once rather than on every pass. The
+// label of each statement moves to its LDB so branches to it also load the base.
+// Returns the number of pairs inserted
+int insertBaseLoads(baseRegion* regions, int regionCount, referenceTable* table, sourceLines* source)
+{
+	statementFlow* flow = allocateMemory(sizeof(statementFlow) * (source->count + 1));
+	sourceLines updated = { NULL, 0, 0 };
+	char statement[INPUT_BUF_SIZE];
+	int next = 0, limit = -1;
+	int inserted = 0;
+
+	traceStatementFlow(source, flow);
+	for (int x = 0; x < regionCount; x++)
+	{
+		int top = table->references[regions[x].firstReference].line;
+		int bottom = table->references[regions[x].lastReference].line;
+		int end = bottom;
+		int following = x + 1 < regionCount ? table->references[regions[x + 1].firstReference].line : source->count;
+
+		// The top never moves into the previous region
+		while (!flow[top].entry && flow[top].fallsThrough && flow[top].previous > limit)
+		{
+			top = flow[top].previous;
+		}
+
+		// Instructions that continue from the last reference still hold the base, so a loop that
+		// closes below the last reference is not an entry
+		for (int line = bottom + 1; line < following; line++)
+		{
+			if (source->lines[line][0] == COMMENT || source->lines[line][0] < ' ')
+			{
+				continue;
+			}
+			if (!flow[line].instruction || !flow[line].fallsThrough || flow[line].entry || flow[line].firstJump >= 0)
+			{
+				break;
+			}
+			end = line;
+		}
+
+		for (int line = top; line <= bottom; line++)
+		{
+			if (!flow[line].instruction || (line > top && !flow[line].entry &&
+				(flow[line].firstJump < 0 || (flow[line].firstJump >= top && flow[line].lastJump <= end))))
+			{
+				continue;
+			}
+			appendSourceLines(&updated, source, next, line - next);
+
+			// The LDB is always Format 4: as Format 3 it could be encoded relative to the base that
+			// the BASE directive above it claims, which is not in register B on entry
+			memcpy(statement, source->lines[line], SEGMENT_SIZE - 1);
+			snprintf(&statement[SEGMENT_SIZE - 1], INPUT_BUF_SIZE - (SEGMENT_SIZE - 1), "%-*s#%s\n", SEGMENT_SIZE - 1, "+LDB", regions[x].base);
+			appendSourceLine(&updated, statement);
+			snprintf(statement, INPUT_BUF_SIZE, "%-*s%-*s%s\n", SEGMENT_SIZE - 1, "", SEGMENT_SIZE - 1, "BASE", regions[x].base);
+			appendSourceLine(&updated, statement);
+
+			appendSourceLine(&updated, source->lines[line]);
+			memset(updated.lines[updated.count - 1], ' ', SEGMENT_SIZE - 1);
+			next = line + 1;
+			regions[x].loadCount++;
+			inserted++;
+		}
+		limit = end;
+	}
+	appendSourceLines(&updated, source, next, source->count - next);
+
+	freeSourceLines(source);
+	*source = updated;
+	releaseMemory(flow);
+	return inserted;
+}
+
+// Records for every statement whether control falls through into it from the statement above,
+// whether it can be reached with another value in register B, and which lines jump to its
+// label. Subroutine entries are the targets of JSUB and the symbols named by EXTDEF and END;
+// jumps through indirect operands are only followed as returns to the statement after a JSUB
+void traceStatementFlow(sourceLines* source, statementFlow* flow)
+{
+	labeledLine* labels = allocateMemory(sizeof(labeledLine) * (source->count + 1));
+	int labelCount = 0, previous = -1;
+	bool fallsThrough = false, changesBase = false;
+	segment segments;
+	char name[OPERAND_SIZE];
+	char* position;
+
+	for (int x = 0; x < source->count; x++)
+	{
+		char* operation;
+		int directiveType;
+
+		flow[x] = (statementFlow){ previous, -1, -1, false, fallsThrough, changesBase };
+		if (source->lines[x][0] == COMMENT || source->lines[x][0] < ' ')
+		{
+			flow[x].fallsThrough = flow[x].entry = false;
+			continue;
+		}
+		prepareSegments(source->lines[x], &segments);
+		if (strlen(segments.label) > 0)
+		{
+			snprintf(labels[labelCount].name, NAME_SIZE, "%.*s", NAME_SIZE - 1, segments.label);
+			labels[labelCount++].line = x;
+		}
+
+		// J and RSUB never continue into the next statement, and a call may return with any base
+		operation = segments.operation[0] == EXTENDED_CHARACTER ? &segments.operation[1] : segments.operation;
+		directiveType = isDirective(segments.operation);
+		flow[x].instruction = isOpcode(operation);
+		fallsThrough = flow[x].instruction && strcmp(operation, "J") != 0 && strcmp(operation, "RSUB") != 0;
+		changesBase = strcmp(operation, "JSUB") == 0 || strcmp(operation, "LDB") == 0 || isBaseDirective(directiveType) || isUseDirective(directiveType);
+		previous = x;
+	}
+	qsort(labels, labelCount, sizeof(labeledLine), compareLabels);
+
+	for (int x = 0; x < source->count; x++)
+	{
+		char* operation;
+		int directiveType, line;
+
+		if (source->lines[x][0] == COMMENT || source->lines[x][0] < ' ')
+		{
+			continue;
+		}
+		prepareSegments(source->lines[x], &segments);
+		operation = segments.operation[0] == EXTENDED_CHARACTER ? &segments.operation[1] : segments.operation;
+		directiveType = isDirective(segments.operation);
+
+		if (isExtdefDirective(directiveType) || isEndDirective(directiveType))
+		{
+			for (char* symbolName = strtok_r(segments.operand, ",", &position); symbolName != NULL; symbolName = strtok_r(NULL, ",", &position))
+			{
+				if ((line = findLabel(labels, labelCount, symbolName)) >= 0)
+				{
+					flow[line].entry = true;
+				}
+			}
+		}
+		else if (flow[x].instruction && operation[0] == JUMP_CHARACTER &&
+			segments.operand[0] != IMMEDIATE_CHARACTER && segments.operand[0] != INDIRECT_CHARACTER)
+		{
+			getOperandSymbol(segments.operand, name);
+			if ((line = findLabel(labels, labelCount, name)) < 0)
+			{
+				continue;
+			}
+			if (strcmp(operation, "JSUB") == 0)
+			{
+				flow[line].entry = true;
+			}
+			else
+			{
+				flow[line].firstJump = flow[line].firstJump < 0 ? x : flow[line].firstJump;
+				flow[line].lastJump = x;
+			}
+		}
+	}
+	releaseMemory(labels);
+}
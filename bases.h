@@ -0,0 +1,36 @@
+#pragma once
+
+struct controlSection;
+
+// Used to store a suggested BASE region covering consecutive out-of-range references
+typedef struct baseRegion
+{
+	int firstReference;     // Index of the first reference in the region
+	int lastReference;      // Index of the last reference in the region
+	int lowTarget;          // Lowest operand address in the region; the suggested base value
+	int highTarget;         // Highest operand address in the region
+	int coveredCount;       // References the BASE already in effect reaches
+	int missCount;          // References outside the PC-relative range
+	char base[NAME_SIZE];   // Symbol to load into register B
+	int loadCount;          // LDB/BASE pairs inserted at the entry points of the region
+} baseRegion;
+
+// Used to look up the statement that defines a label
+typedef struct labeledLine
+{
+	char name[NAME_SIZE];
+	int line;
+} labeledLine;
+
+// Used to find the statements where control can enter a BASE region
+typedef struct statementFlow
+{
+	int previous;           // Line of the statement above, skipping comments; -1 if none
+	int firstJump;          // Line of the first J, JEQ, JGT or JLT to the label of the statement; -1 if none
+	int lastJump;           // Line of the last jump to the label of the statement
+	bool instruction;       // True for machine instructions
+	bool fallsThrough;      // True if the statement above continues into this one
+	bool entry;             // True if control can arrive with another value in register B
+} statementFlow;
+
+int analyzeBases(struct controlSection* section, options* settings);
@@ -0,0 +1,88 @@
+#include "headers.h"
+
+#define INITIAL_BLOCK_CAPACITY 4
+
+// Places every program block behind the blocks before it, in order of first use, and moves
+// the symbols and recorded references of each block from its Pass 1 location counter to
+// the placed address. The location counter of the section is left at the end of the last block.
+void placeProgramBlocks(controlSection* section, int block, int current)
+{
+	programBlock* blocks = section->blocks;
+	referenceTable* table = &section->references;
+	int offset;
+
+	blocks[block].current = current;
+	blocks[0].first = section->addresses.start;
+	for (int x = 0; x < section->blockCount; x++)
+	{
+		blocks[x].length = blocks[x].current - blocks[x].first;
+		blocks[x].start = x == 0 ? section->addresses.start : blocks[x - 1].start + blocks[x - 1].length;
+	}
+	if (section->blockCount == 1)
+	{
+		return;
+	}
+
+	for (int x = 0; x < SYMBOL_TABLE_SIZE; x++)
+	{
+		if (section->symbols[x] != NULL)
+		{
+			offset = blocks[section->symbols[x]->block].start - blocks[section->symbols[x]->block].first;
+			section->symbols[x]->address += offset;
+		}
+	}
+	for (int x = 0; x < table->count; x++)
+	{
+		offset = blocks[table->references[x].block].start - blocks[table->references[x].block].first;
+		table->references[x].address += offset;
+	}
+	section->addresses.current = blocks[section->blockCount - 1].start + blocks[section->blockCount - 1].length;
+}
+
+// Discards the program blocks of a previous Pass 1 and selects the default block
+void resetProgramBlocks(controlSection* section)
+{
+	if (section->blocks == NULL)
+	{
+		section->blocks = allocateMemory(sizeof(programBlock) * INITIAL_BLOCK_CAPACITY);
+		section->blockCapacity = INITIAL_BLOCK_CAPACITY;
+	}
+	memset(&section->blocks[0], 0, sizeof(programBlock));
+	section->blockCount = 1;
+}
+
+// Starts the location counter of every block at its placed address for Pass 2
+void rewindProgramBlocks(controlSection* section)
+{
+	for (int x = 0; x < section->blockCount; x++)
+	{
+		section->blocks[x].current = section->blocks[x].start;
+	}
+}
+
+// Saves the location counter of the active block and selects the named block, adding it
+// when it is used for the first time
+// Returns the index of the selected block; its counter is in section->blocks[index].current
+int useProgramBlock(controlSection* section, int block, char* name, int current)
+{
+	int x;
+
+	section->blocks[block].current = current;
+	for (x = 0; x < section->blockCount; x++)
+	{
+		if (strncmp(section->blocks[x].name, name, NAME_SIZE - 1) == 0)
+		{
+			return x;
+		}
+	}
+
+	if (section->blockCount == section->blockCapacity)
+	{
+		section->blockCapacity *= 2;
+		section->blocks = resizeMemory(section->blocks, sizeof(programBlock) * section->blockCapacity);
+	}
+	memset(&section->blocks[x], 0, sizeof(programBlock));
+	strncpy(section->blocks[x].name, name, NAME_SIZE - 1);
+	section->blockCount++;
+	return x;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+struct controlSection;
+
+// Used to store one program block selected by the USE directive
+typedef struct programBlock
+{
+	char name[NAME_SIZE]; // Operand of the USE directive; empty for the default block
+	int first;            // Pass 1 location counter value at the start of the block
+	int current;          // Location counter of the block
+	int start;            // Address of the block once placed behind the blocks before it
+	int length;
+} programBlock;
+
+void placeProgramBlocks(struct controlSection* section, int block, int current);
+void resetProgramBlocks(struct controlSection* section);
+void rewindProgramBlocks(struct controlSection* section);
+int useProgramBlock(struct controlSection* section, int block, char* name, int current);
@@ -0,0 +1,418 @@
+#include "headers.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CACHE_COPY_BUFFER_SIZE 65536
+#define CACHE_KEY_DIGITS 16
+#define CACHE_KEY_TEXT_SIZE 64
+#define CACHE_PATH_SIZE 4096
+#define CHECK_MULTIPLIER 0x9E3779B97F4A7C15ull
+#define CHECK_OFFSET_BASIS 0x243F6A8885A308D3ull
+#define FNV_OFFSET_BASIS 14695981039346656037ull
+#define FNV_PRIME 1099511628211ull
+
+// Used to store one entry of the cache while the least recently used entries are evicted
+typedef struct cacheEntry
+{
+	char name[CACHE_KEY_DIGITS + 1];
+	long size;
+	time_t used; // Modification time of the entry directory, refreshed on every hit
+} cacheEntry;
+
+// Names of the files kept for each entry, in the order of the outputs they hold
+static const char* cacheFiles[] = { "lst", "obj", "sym", "out", "key" };
+
+void addKeyBytes(cacheKey* key, const void* bytes, size_t size);
+int compareCacheEntries(const void* first, const void* second);
+bool copyFile(char* from, char* to);
+void evictCacheEntries(char* directory, long limit);
+int formatCacheKey(char* text, cacheKey* key);
+void makeDirectories(char* directory);
+char* readCachedFile(char* path, size_t* size);
+void removeCacheEntry(char* directory, char* name);
+void updateCacheStatistics(char* directory, int hits, int misses, long* totalHits, long* totalMisses);
+
+// Adds the provided bytes to both hashes of the key: a 64-bit FNV-1a hash and a
+// multiply-rotate hash, so one collision does not make the other collide
+void addKeyBytes(cacheKey* key, const void* bytes, size_t size)
+{
+	const unsigned char* next = (const unsigned char*)bytes;
+
+	for (size_t x = 0; x < size; x++)
+	{
+		key->hash = (key->hash ^ next[x]) * FNV_PRIME;
+		key->check = ((key->check << 5 | key->check >> 59) ^ next[x]) * CHECK_MULTIPLIER;
+	}
+	key->size += size;
+}
+
+// Orders cache entries from least to most recently used for qsort()
+int compareCacheEntries(const void* first, const void* second)
+{
+	time_t left = ((const cacheEntry*)first)->used;
+	time_t right = ((const cacheEntry*)second)->used;
+
+	return left < right ? -1 : left > right;
+}
+
+// Computes the cache key of a program from the assembler version, the options that change
+// the output and the source lines after macro expansion
+cacheKey computeCacheKey(sourceLines* source, options* settings)
+{
+	bool flags[] = { settings->analyzeBases, settings->crossReference, settings->extendedRecords, settings->insertBases, settings->optimizeFormats, settings->skipListing };
+	cacheKey key = { FNV_OFFSET_BASIS, CHECK_OFFSET_BASIS, 0 };
+
+	addKeyBytes(&key, ASSEMBLER_VERSION, strlen(ASSEMBLER_VERSION));
+	addKeyBytes(&key, flags, sizeof(flags));
+	for (int x = 0; x < source->count; x++)
+	{
+		addKeyBytes(&key, source->lines[x], strnlen(source->lines[x], INPUT_BUF_SIZE));
+		addKeyBytes(&key, "", 1);
+	}
+	return key;
+}
+
+// Copies a file, sharing its blocks with a reflink when the file system supports it
+// Returns true if the file was copied; otherwise, false
+bool copyFile(char* from, char* to)
+{
+	char buffer[CACHE_COPY_BUFFER_SIZE];
+	int source = open(from, O_RDONLY);
+	int destination = source >= 0 ? open(to, O_WRONLY | O_CREAT | O_TRUNC, 0644) : -1;
+	ssize_t count = 0;
+
+	if (destination >= 0 && ioctl(destination, FICLONE, source) != 0)
+	{
+		while ((count = read(source, buffer, sizeof(buffer))) > 0)
+		{
+			if (write(destination, buffer, count) != count)
+			{
+				count = -1;
+				break;
+			}
+		}
+	}
+	if (source >= 0)
+	{
+		close(source);
+	}
+	if (destination >= 0)
+	{
+		close(destination);
+	}
+	return source >= 0 && destination >= 0 && count == 0;
+}
+
+// Prints the hit and miss counts and the size of the cache
+void displayCacheStatistics(char* directory, long limit)
+{
+	char path[CACHE_PATH_SIZE];
+	long hits, misses, entries = 0, size = 0;
+	struct dirent* item;
+	DIR* entryDirectory;
+
+	updateCacheStatistics(directory, 0, 0, &hits, &misses);
+	DIR* cacheDirectory = opendir(directory);
+	while (cacheDirectory != NULL && (item = readdir(cacheDirectory)) != NULL)
+	{
+		if (strlen(item->d_name) != CACHE_KEY_DIGITS)
+		{
+			continue;
+		}
+		entries++;
+		snprintf(path, CACHE_PATH_SIZE, "%s/%s", directory, item->d_name);
+		if ((entryDirectory = opendir(path)) != NULL)
+		{
+			struct dirent* file;
+			struct stat status;
+			while ((file = readdir(entryDirectory)) != NULL)
+			{
+				snprintf(path, CACHE_PATH_SIZE, "%s/%s/%s", directory, item->d_name, file->d_name);
+				if (file->d_name[0] != '.' && stat(path, &status) == 0)
+				{
+					size += status.st_size;
+				}
+			}
+			closedir(entryDirectory);
+		}
+	}
+	if (cacheDirectory != NULL)
+	{
+		closedir(cacheDirectory);
+	}
+
+	printf("\nCache Directory: %s\n", directory);
+	printf("Hits: %ld\nMisses: %ld\nHit Rate: %.1f%%\n", hits, misses, hits + misses > 0 ? 100.0 * hits / (hits + misses) : 0.0);
+	printf("Entries: %ld\nSize (bytes): %ld of %ld\n", entries, size, limit);
+}
+
+// Removes the least recently used entries until the cache fits the size limit
+void evictCacheEntries(char* directory, long limit)
+{
+	char path[CACHE_PATH_SIZE];
+	cacheEntry* entries = NULL;
+	int count = 0, capacity = 0;
+	long total = 0;
+	struct dirent* item;
+	DIR* cacheDirectory = opendir(directory);
+
+	while (cacheDirectory != NULL && (item = readdir(cacheDirectory)) != NULL)
+	{
+		struct stat status;
+		if (strlen(item->d_name) != CACHE_KEY_DIGITS)
+		{
+			continue;
+		}
+		if (count == capacity)
+		{
+			capacity = capacity > 0 ? capacity * 2 : 64;
+			entries = resizeMemory(entries, sizeof(cacheEntry) * capacity);
+		}
+		strcpy(entries[count].name, item->d_name);
+		snprintf(path, CACHE_PATH_SIZE, "%s/%s", directory, item->d_name);
+		entries[count].used = stat(path, &status) == 0 ? status.st_mtime : 0;
+		entries[count].size = 0;
+		for (int x = 0; x < (int)(sizeof(cacheFiles) / sizeof(cacheFiles[0])); x++)
+		{
+			snprintf(path, CACHE_PATH_SIZE, "%s/%s/%s", directory, item->d_name, cacheFiles[x]);
+			if (stat(path, &status) == 0)
+			{
+				entries[count].size += status.st_size;
+			}
+		}
+		total += entries[count].size;
+		count++;
+	}
+	if (cacheDirectory != NULL)
+	{
+		closedir(cacheDirectory);
+	}
+
+	qsort(entries, count, sizeof(cacheEntry), compareCacheEntries);
+	for (int x = 0; x < count && total > limit; x++)
+	{
+		removeCacheEntry(directory, entries[x].name);
+		total -= entries[x].size;
+	}
+	releaseMemory(entries);
+}
+
+// Writes the key as the text kept in the key file of its entry
+// Returns the length of the text
+int formatCacheKey(char* text, cacheKey* key)
+{
+	return snprintf(text, CACHE_KEY_TEXT_SIZE, "%016llx %016llx %llu\n", (unsigned long long)key->hash, (unsigned long long)key->check, (unsigned long long)key->size);
+}
+
+// Creates the directory and any missing parent directories
+void makeDirectories(char* directory)
+{
+	char path[CACHE_PATH_SIZE];
+
+	snprintf(path, CACHE_PATH_SIZE, "%s", directory);
+	for (char* separator = strchr(path + 1, '/'); separator != NULL; separator = strchr(separator + 1, '/'))
+	{
+		*separator = '\0';
+		mkdir(path, 0755);
+		*separator = '/';
+	}
+	mkdir(path, 0755);
+}
+
+// Reads a whole file of a cache entry into memory
+// Returns the contents; NULL if the file cannot be read
+char* readCachedFile(char* path, size_t* size)
+{
+	FILE* file = fopen(path, "rb");
+	struct stat status;
+	char* contents = NULL;
+
+	if (file == NULL)
+	{
+		return NULL;
+	}
+	if (fstat(fileno(file), &status) == 0)
+	{
+		contents = allocateMemory(status.st_size + 1);
+		*size = status.st_size;
+		if (fread(contents, 1, *size, file) != *size)
+		{
+			releaseMemory(contents);
+			contents = NULL;
+		}
+	}
+	fclose(file);
+	return contents;
+}
+
+// Deletes the files and directory of one cache entry
+void removeCacheEntry(char* directory, char* name)
+{
+	char path[CACHE_PATH_SIZE];
+
+	for (int x = 0; x < (int)(sizeof(cacheFiles) / sizeof(cacheFiles[0])); x++)
+	{
+		snprintf(path, CACHE_PATH_SIZE, "%s/%s/%s", directory, name, cacheFiles[x]);
+		unlink(path);
+	}
+	snprintf(path, CACHE_PATH_SIZE, "%s/%s", directory, name);
+	rmdir(path);
+}
+
+// Writes the outputs of a cached program to the output files, leaving the files that already
+// hold them untouched, and its summary to the provided stream, marking the entry as recently
+// used. A NULL listing filename skips the listing. Records a hit or a miss in the statistics
+// Returns true on a hit; otherwise, false
+bool restoreCachedOutputs(char* directory, cacheKey* key, char* lstFilename, char* objFilename, char* symFilename, FILE* output)
+{
+	char* destinations[] = { lstFilename, objFilename, symFilename, NULL, NULL };
+	char* contents[sizeof(cacheFiles) / sizeof(cacheFiles[0])] = { NULL };
+	size_t sizes[sizeof(cacheFiles) / sizeof(cacheFiles[0])] = { 0 };
+	char path[CACHE_PATH_SIZE];
+	char expected[CACHE_KEY_TEXT_SIZE];
+	int length = formatCacheKey(expected, key);
+	bool hit = true;
+
+	// The key file comes first, so a different program with the same hash reads nothing more
+	for (int x = 4; x >= 0 && hit; x--)
+	{
+		if (x < 3 && destinations[x] == NULL)
+		{
+			continue;
+		}
+		hit = snprintf(path, CACHE_PATH_SIZE, "%s/%016llx/%s", directory, (unsigned long long)key->hash, cacheFiles[x]) < CACHE_PATH_SIZE &&
+			(contents[x] = readCachedFile(path, &sizes[x])) != NULL;
+		hit = hit && (x != 4 || (sizes[x] == (size_t)length && memcmp(contents[x], expected, length) == 0));
+	}
+
+	if (hit)
+	{
+		for (int x = 0; x < 3; x++)
+		{
+			if (destinations[x] != NULL)
+			{
+				writeFileIfChanged(destinations[x], contents[x], sizes[x]);
+			}
+		}
+		if (output != NULL)
+		{
+			fwrite(contents[3], 1, sizes[3], output);
+		}
+		snprintf(path, CACHE_PATH_SIZE, "%s/%016llx", directory, (unsigned long long)key->hash);
+		utimensat(AT_FDCWD, path, NULL, 0);
+	}
+	for (int x = 0; x < (int)(sizeof(cacheFiles) / sizeof(cacheFiles[0])); x++)
+	{
+		releaseMemory(contents[x]);
+	}
+	updateCacheStatistics(directory, hit, !hit, NULL, NULL);
+	return hit;
+}
+
+// Adds the outputs of a program to the cache, then evicts the least recently used entries
+// beyond the size limit. The entry is built under a temporary name and renamed into place,
+// so concurrent runs never see a partial entry. An entry of another program with the same
+// hash is replaced
+void storeCachedOutputs(char* directory, cacheKey* key, long limit, char* lstFilename, char* objFilename, char* symFilename, char* outputText, size_t outputSize)
+{
+	char* sources[] = { lstFilename, objFilename, symFilename };
+	char name[CACHE_KEY_DIGITS + 1];
+	char temporary[CACHE_PATH_SIZE];
+	char path[CACHE_PATH_SIZE + CACHE_KEY_DIGITS + 2]; // Room for the temporary name and a file name
+	char text[CACHE_KEY_TEXT_SIZE];
+	int length = formatCacheKey(text, key);
+	bool stored = true;
+	FILE* summary;
+
+	makeDirectories(directory);
+	snprintf(name, sizeof(name), "%016llx", (unsigned long long)key->hash);
+	if (snprintf(temporary, CACHE_PATH_SIZE, "%s/tmp.%d", directory, (int)getpid()) >= CACHE_PATH_SIZE)
+	{
+		return; // The directory name is too long to hold an entry
+	}
+	mkdir(temporary, 0755);
+	for (int x = 0; x < 3 && stored; x++)
+	{
+		snprintf(path, sizeof(path), "%s/%s", temporary, cacheFiles[x]);
+		stored = sources[x] == NULL || copyFile(sources[x], path);
+	}
+	for (int x = 3; x < 5 && stored; x++)
+	{
+		snprintf(path, sizeof(path), "%s/%s", temporary, cacheFiles[x]);
+		if ((summary = fopen(path, "w")) != NULL)
+		{
+			stored = x == 3 ? fwrite(outputText, 1, outputSize, summary) == outputSize : fwrite(text, 1, length, summary) == (size_t)length;
+			stored &= fclose(summary) == 0;
+		}
+		else
+		{
+			stored = false;
+		}
+	}
+
+	snprintf(path, sizeof(path), "%s/%s", directory, name);
+	if (stored && rename(temporary, path) != 0)
+	{
+		removeCacheEntry(directory, name);
+		stored = rename(temporary, path) == 0;
+	}
+	if (!stored)
+	{
+		for (int x = 0; x < (int)(sizeof(cacheFiles) / sizeof(cacheFiles[0])); x++)
+		{
+			snprintf(path, sizeof(path), "%s/%s", temporary, cacheFiles[x]);
+			unlink(path);
+		}
+		rmdir(temporary);
+	}
+	evictCacheEntries(directory, limit);
+}
+
+// Adds to the hit and miss counts kept in the cache directory, holding a file lock so
+// concurrent runs do not lose counts. The totals are returned when requested
+void updateCacheStatistics(char* directory, int hits, int misses, long* totalHits, long* totalMisses)
+{
+	char path[CACHE_PATH_SIZE];
+	char text[64] = { '\0' };
+	long storedHits = 0, storedMisses = 0;
+	int descriptor;
+	ssize_t length;
+
+	if (hits + misses > 0)
+	{
+		makeDirectories(directory);
+	}
+	snprintf(path, CACHE_PATH_SIZE, "%s/stats", directory);
+	descriptor = open(path, hits + misses > 0 ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+	if (descriptor >= 0)
+	{
+		flock(descriptor, LOCK_EX);
+		if ((length = read(descriptor, text, sizeof(text) - 1)) > 0)
+		{
+			text[length] = '\0';
+			sscanf(text, "%ld %ld", &storedHits, &storedMisses);
+		}
+		storedHits += hits;
+		storedMisses += misses;
+		if (hits + misses > 0)
+		{
+			length = snprintf(text, sizeof(text), "%ld %ld\n", storedHits, storedMisses);
+			if (pwrite(descriptor, text, length, 0) == length)
+			{
+				ftruncate(descriptor, length);
+			}
+		}
+		flock(descriptor, LOCK_UN);
+		close(descriptor);
+	}
+	if (totalHits != NULL)
+	{
+		*totalHits = storedHits;
+		*totalMisses = storedMisses;
+	}
+}
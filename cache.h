@@ -0,0 +1,18 @@
+#pragma once
+
+#define CACHE_DEFAULT_LIMIT (64L * 1024 * 1024)
+#define CACHE_DIRECTORY_VARIABLE "SICXE_CACHE_DIR"
+
+// Used to identify a program in the cache. The hash names the entry; the second hash and the
+// size are stored with it and compared on a hit, so a hash collision is a miss
+typedef struct cacheKey
+{
+	uint64_t hash;
+	uint64_t check;
+	uint64_t size;
+} cacheKey;
+
+cacheKey computeCacheKey(sourceLines* source, options* settings);
+void displayCacheStatistics(char* directory, long limit);
+bool restoreCachedOutputs(char* directory, cacheKey* key, char* lstFilename, char* objFilename, char* symFilename, FILE* output);
+void storeCachedOutputs(char* directory, cacheKey* key, long limit, char* lstFilename, char* objFilename, char* symFilename, char* outputText, size_t outputSize);
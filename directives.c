@@ -1,77 +1,116 @@
 #include "headers.h"
 
+#define HEX_DIGITS "0123456789ABCDEFabcdef"
 #define SINGLE_QUOTE 39
+#define WORD_MAX_VALUE 0xFFFFFF
+#define WORD_MIN_VALUE -0x800000
 
 // List of valid directives, ERROR helps isDirective()
 enum directives {
-	ERROR, BASE, BYTE, END, RESB, RESW, START
+	ERROR, BASE, BYTE, CSECT, END, EXTDEF, EXTREF, RESB, RESW, START, USE, WORD
 };
 
-// Converts a character to its hexadecimal value
-int charToHex(char c) {
-    return (int)c;
-}
+void decodeHexDigits(const char* hex, int digits, unsigned char* bytes);
 
-// Returns the value associated with a BYTE directive
-int getByteValue(int directiveType, char* string)
+// Decodes pairs of hexadecimal digits into bytes, eight digits at a time. Each digit's low
+// nibble is its value, plus 9 for the letters, whose bit 6 is set; the nibbles of each
+// pair are then merged and packed into four bytes
+void decodeHexDigits(const char* hex, int digits, unsigned char* bytes)
 {
-	char charTemp[SINGLE_QUOTE];
-	int bytesRequired = -1;
+	int x = 0;
 
-	if (strstr(string, "X'") != NULL) {	// X Value
-		if (strlen(string) > 6){
-			displayError(OUT_OF_RANGE_BYTE, string);
-			exit(1);
+	for (; x + 8 <= digits; x += 8)
+	{
+		uint64_t chunk = 0;
+
+		for (int y = 0; y < 8; y++)
+		{
+			chunk |= (uint64_t)(unsigned char)hex[x + y] << (8 * y);
 		}
-		else{
-			strncpy(charTemp, &string[2], 2);
-            charTemp[2] = '\0';  
-			bytesRequired = strtol(charTemp, NULL, 16);
+		chunk = (chunk & 0x0F0F0F0F0F0F0F0FULL) + ((chunk >> 6) & 0x0101010101010101ULL) * 9;
+		chunk = ((chunk << 4) | (chunk >> 8)) & 0x00FF00FF00FF00FFULL;
+		chunk = (chunk | (chunk >> 8)) & 0x0000FFFF0000FFFFULL;
+		chunk = chunk | (chunk >> 16);
+		for (int y = 0; y < 4; y++)
+		{
+			bytes[x / 2 + y] = (chunk >> (8 * y)) & 0xFF;
 		}
-	} else if (strstr(string, "C'") != NULL) {	// C String
-        int len = strlen(string) - 3;
+	}
+	for (; x < digits; x += 2)
+	{
+		int high = (hex[x] & 0x0F) + ((hex[x] >> 6) & 1) * 9;
+		int low = (hex[x + 1] & 0x0F) + ((hex[x + 1] >> 6) & 1) * 9;
+		bytes[x / 2] = (high << 4) | low;
+	}
+}
 
-        // Each character will be represented by 2 hexadecimal digits
-        char hexString[2 * len + 1]; 
+// Decodes the operand of a BYTE or WORD directive into the bytes it stores: a byte for each
+// pair of digits of X'..', a byte for each character of C'..', or the three bytes of a WORD.
+// The bytes are only counted when bytes is NULL
+// Returns the number of bytes
+int getDataBytes(int directiveType, char* string, unsigned char* bytes)
+{
+	char* close = strrchr(string, SINGLE_QUOTE);
+	int length = close != NULL && close > string + 1 ? close - string - 2 : -1;
 
-        // Convert each character to its equivalent hexadecimal value
-        for (int i = 2, j = 0; i < len + 2; i++, j += 2) {
-            int hexVal = charToHex(string[i]);
-            sprintf(hexString + j, "%02X", hexVal);
-        }
-        bytesRequired = (int)strtol(hexString, NULL, 16);
-    }
+	if (directiveType == WORD)
+	{
+		char* end;
+		long value = strtol(string, &end, 10);
 
-	return bytesRequired;
+		if (end == string || *end != '\0' || value < WORD_MIN_VALUE || value > WORD_MAX_VALUE)
+		{
+			displayError(OUT_OF_RANGE_WORD, string);
+			exit(1);
+		}
+		for (int x = 0; bytes != NULL && x < 3; x++)
+		{
+			bytes[x] = (value >> (8 * (2 - x))) & 0xFF;
+		}
+		return 3;
+	}
+	if (string[0] == 'X' && string[1] == SINGLE_QUOTE)
+	{
+		if (length <= 0 || length % 2 != 0 || (int)strspn(&string[2], HEX_DIGITS) < length)
+		{
+			displayError(OUT_OF_RANGE_BYTE, string);
+			exit(1);
+		}
+		if (bytes != NULL)
+		{
+			decodeHexDigits(&string[2], length, bytes);
+		}
+		return length / 2;
+	}
+	if (string[0] == 'C' && string[1] == SINGLE_QUOTE && length > 0)
+	{
+		if (bytes != NULL)
+		{
+			memcpy(bytes, &string[2], length);
+		}
+		return length;
+	}
+	displayError(OUT_OF_RANGE_BYTE, string);
+	exit(1);
 }
 
 // Returns the number of bytes required to store the BYTE directive value in memory
 int getMemoryAmount(int directiveType, char* string)
 {
-	char hex[9] = { '\0' };
-	int temp = 0;
-
 	switch (directiveType)
 	{
 		case BASE:
+		case CSECT:
 		case END:
+		case EXTDEF:
+		case EXTREF:
 		case START:
+		case USE:
 			return 0;
 			break;
 		case BYTE:
-			if (string[0] == 'X')
-			{
-				if (strlen(string) != 5)
-				{
-					displayError(OUT_OF_RANGE_BYTE, string);
-					exit(-1);
-				}
-				else
-					return 1;
-			}
-			else if (string[0] == 'C')
-				return strlen(string) - 3;
-			break;
+		case WORD:
+			return getDataBytes(directiveType, string, NULL);
 		case RESB:
 			return strtol(string, NULL, 10);
 			break;
@@ -88,10 +127,16 @@ bool isBaseDirective(int directiveType)
 	return directiveType == BASE;
 }
 
-// Returns true if the provided directive type is the BYTE directive; otherwise, false
+// Returns true if the provided directive type is the CSECT directive; otherwise, false
+bool isCsectDirective(int directiveType)
+{
+	return directiveType == CSECT;
+}
+
+// Returns true if the provided directive type is the BYTE or WORD directive; otherwise, false
 bool isDataDirective(int directiveType)
 {
-	return directiveType == BYTE;
+	return directiveType == BYTE || directiveType == WORD;
 }
 
 // Tests whether the provided string is a valid directive
@@ -100,10 +145,15 @@ int isDirective(char* string)
 {
 	if (strcmp(string, "BASE") == 0) { return BASE; }
 	else if (strcmp(string, "BYTE") == 0) { return BYTE; }
+	else if (strcmp(string, "CSECT") == 0) { return CSECT; }
 	else if(strcmp(string, "END") == 0) { return END; }
+	else if (strcmp(string, "EXTDEF") == 0) { return EXTDEF; }
+	else if (strcmp(string, "EXTREF") == 0) { return EXTREF; }
 	else if (strcmp(string, "RESB") == 0) { return RESB; }
 	else if (strcmp(string, "RESW") == 0) { return RESW; }
 	else if (strcmp(string, "START") == 0) { return START; }
+	else if (strcmp(string, "USE") == 0) { return USE; }
+	else if (strcmp(string, "WORD") == 0) { return WORD; }
 	else { return ERROR; }
 }
 
@@ -113,6 +163,18 @@ bool isEndDirective(int directiveType)
 	return directiveType == END;
 }
 
+// Returns true if the provided directive type is the EXTDEF directive; otherwise, false
+bool isExtdefDirective(int directiveType)
+{
+	return directiveType == EXTDEF;
+}
+
+// Returns true if the provided directive type is the EXTREF directive; otherwise, false
+bool isExtrefDirective(int directiveType)
+{
+	return directiveType == EXTREF;
+}
+
 // Returns true if the provided directive type is the RESB or RESW directive; otherwise, false
 bool isReserveDirective(int directiveType)
 {
@@ -127,4 +189,10 @@ bool isReserveDirective(int directiveType)
 bool isStartDirective(int directiveType)
 {
 	return directiveType == START;
+}
+
+// Returns true if the provided directive type is the USE directive; otherwise, false
+bool isUseDirective(int directiveType)
+{
+	return directiveType == USE;
 }
\ No newline at end of file
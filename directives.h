@@ -12,12 +12,16 @@
 
 // Pass 1 functions
 int getMemoryAmount(int directiveType, char* string);
+bool isCsectDirective(int directiveType);
 int isDirective(char* string);
+bool isExtrefDirective(int directiveType);
 bool isStartDirective(int directiveType);
+bool isUseDirective(int directiveType);
 
 // Pass 2 functions
-int getByteValue(int directiveType, char* string);
+int getDataBytes(int directiveType, char* string, unsigned char* bytes);
 bool isBaseDirective(int directiveType);
 bool isDataDirective(int directiveType);
 bool isEndDirective(int directiveType);
+bool isExtdefDirective(int directiveType);
 bool isReserveDirective(int directiveType);
\ No newline at end of file
@@ -0,0 +1,1125 @@
+#include "headers.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DISPLACEMENT_SIGN 0x800
+#define FLAG_B 0x04
+#define FLAG_E 0x01
+#define FLAG_I 0x10
+#define FLAG_N 0x20
+#define FLAG_P 0x02
+#define FLAG_X 0x08
+#define LISTING_BUFFER_SIZE (1 << 20)
+#define LISTING_LINE_SIZE 128
+#define MAX_DATA_BYTES 4
+#define MAX_NAMES_PER_STATEMENT 6
+#define REGISTER_COUNT 6
+#define RESULT_SIZE 80
+#define RSUB_VALUE 0x4C
+#define STATEMENT_DATA 1
+#define STATEMENT_INSTRUCTION 0
+#define STATEMENT_RESERVE 2
+#define UNTRACED -2
+
+// Used to collect the statements and labels of one control section while it is disassembled
+typedef struct disassembly
+{
+	objectProgram* program;
+	int section;                  // Index of the section in the object and symbol files
+	symbolFile* symbols;          // NULL if no symbol file was found
+	decodedStatement* statements;
+	int statementCount;
+	char (*labels)[NAME_SIZE];    // Label of each address of the section; empty if none
+	int* entries;                 // Addresses control enters the section at
+	int entryCount;
+} disassembly;
+
+// Used to collect listing text so it is written in large blocks instead of line by line
+typedef struct listingText
+{
+	FILE* output;     // File the text is written to when the buffer fills; NULL to keep it all
+	char* text;
+	size_t size;
+	size_t capacity;
+} listingText;
+
+void addExternalEntries(disassembly* code, int count);
+int appendDecimal(char* line, int length, int value);
+int appendField(char* line, int length, const char* text, int width);
+int appendHex(char* line, int length, unsigned int value, int digits);
+bool decodeInstruction(disassembly* code, int offset, int base, decodedStatement* statement);
+void decodeProgram(disassembly* code);
+bool disassembleFile(char* filename, listingText* listing, bool verify, void (*assemble)(controlSection*, options*), char* result);
+int discardObjectPrograms(objectProgram** programs, int count);
+void emitExternalSymbols(listingText* listing, sourceLines* source, int address, char* directive, externalSymbol* symbols, int count);
+void emitProgram(disassembly* code, bool last, char* entryLabel, listingText* listing, sourceLines* source);
+void emitStatement(listingText* listing, sourceLines* source, int address, char* label, char* operation, char* operand, unsigned int objectCode, int objectBytes);
+void flushListing(listingText* listing);
+void formatOperand(disassembly* code, decodedStatement* statement, char* operand);
+char* getKnownName(disassembly* code, int address);
+int getLoadedBase(disassembly* code, decodedStatement* statement);
+bool isJump(decodedStatement* statement);
+void nameLabels(disassembly* code);
+int parseHex(const char* text, int digits);
+int readObjectText(const char* text, size_t size, objectProgram** programs);
+char* reserveListing(listingText* listing, size_t length);
+int* traceProgram(disassembly* code);
+bool verifyDisassembly(objectProgram* programs, int count, sourceLines* source, void (*assemble)(controlSection*, options*), char* result);
+
+// Value of each hexadecimal digit + 1; 0 for other characters
+static const unsigned char hexDigits[256] = {
+	['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5, ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+	['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+	['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16
+};
+
+// Register names in register number order
+static const char* registerNames[REGISTER_COUNT] = { "A", "X", "L", "B", "S", "T" };
+
+// Adds the addresses control enters each section at: the E record address, and the sections
+// and EXTDEF symbols another section jumps to through a Format 4 instruction the loader completes
+void addExternalEntries(disassembly* code, int count)
+{
+	for (int x = 0; x < count; x++)
+	{
+		objectProgram* program = code[x].program;
+
+		if (program->entry >= program->start && program->entry < program->start + program->length)
+		{
+			code[x].entries = resizeMemory(code[x].entries, sizeof(int) * (code[x].entryCount + 1));
+			code[x].entries[code[x].entryCount++] = program->entry;
+		}
+	}
+
+	for (int x = 0; x < count; x++)
+	{
+		objectProgram* program = code[x].program;
+
+		for (int y = 0; y < program->modificationCount; y++)
+		{
+			int offset = program->modifications[y].address - 1 - program->start;
+			const opcode* op;
+
+			if (offset < 0 || offset + 4 > program->length || !program->present[offset] || (program->bytes[offset + 1] & FLAG_E) == 0 ||
+				(op = decodeOpcode(program->bytes[offset])) == NULL || op->format != 3 || op->name[0] != 'J')
+			{
+				continue;
+			}
+			for (int z = 0; z < count; z++)
+			{
+				if (z != x && strcmp(code[z].program->name, program->modifications[y].symbol) == 0)
+				{
+					code[z].entries = resizeMemory(code[z].entries, sizeof(int) * (code[z].entryCount + 1));
+					code[z].entries[code[z].entryCount++] = code[z].program->start;
+				}
+				for (int w = 0; z != x && w < code[z].program->definitionCount; w++)
+				{
+					if (strcmp(code[z].program->definitions[w].name, program->modifications[y].symbol) == 0)
+					{
+						code[z].entries = resizeMemory(code[z].entries, sizeof(int) * (code[z].entryCount + 1));
+						code[z].entries[code[z].entryCount++] = code[z].program->definitions[w].address;
+					}
+				}
+			}
+		}
+	}
+}
+
+// Writes the value to the line as decimal digits
+// Returns the new length of the line
+int appendDecimal(char* line, int length, int value)
+{
+	char digits[12];
+	int count = 0;
+	unsigned int magnitude = value < 0 ? 0U - (unsigned int)value : (unsigned int)value;
+
+	if (value < 0)
+	{
+		line[length++] = '-';
+	}
+	do
+	{
+		digits[count++] = '0' + magnitude % 10;
+		magnitude /= 10;
+	} while (magnitude != 0);
+	while (count > 0)
+	{
+		line[length++] = digits[--count];
+	}
+	return length;
+}
+
+// Copies the text to the line and pads it with spaces to the provided width
+// Returns the new length of the line
+int appendField(char* line, int length, const char* text, int width)
+{
+	int start = length;
+
+	while (*text != '\0')
+	{
+		line[length++] = *text++;
+	}
+	while (length - start < width)
+	{
+		line[length++] = ' ';
+	}
+	return length;
+}
+
+// Writes the value to the line as hexadecimal digits; a digit count of 0 writes as few as needed
+// Returns the new length of the line
+int appendHex(char* line, int length, unsigned int value, int digits)
+{
+	static const char hexCharacters[] = "0123456789ABCDEF";
+
+	if (digits == 0)
+	{
+		for (digits = 1; digits < 8 && (value >> (digits * 4)) != 0; digits++);
+	}
+	for (int x = digits - 1; x >= 0; x--)
+	{
+		line[length++] = hexCharacters[(value >> (x * 4)) & 0x0F];
+	}
+	return length;
+}
+
+// Decodes the instruction at the provided section offset using the opcode decode table
+// Returns true if the bytes form an instruction the assembler can reproduce; otherwise, false
+bool decodeInstruction(disassembly* code, int offset, int base, decodedStatement* statement)
+{
+	objectProgram* program = code->program;
+	unsigned char* bytes = &program->bytes[offset];
+	int available = 0;
+	const opcode* op = decodeOpcode(bytes[0]);
+
+	if (op == NULL)
+	{
+		return false;
+	}
+	while (available < 4 && offset + available < program->length && program->present[offset + available])
+	{
+		available++;
+	}
+
+	memset(statement, 0, sizeof(decodedStatement));
+	statement->address = program->start + offset;
+	statement->kind = STATEMENT_INSTRUCTION;
+	statement->op = op;
+	statement->target = -1;
+	statement->base = -1;
+
+	if (op->format == 1)
+	{
+		statement->size = 1;
+		return true;
+	}
+	if (op->format == 2)
+	{
+		statement->size = 2;
+		statement->value = bytes[1];
+		return available >= 2 && (bytes[1] >> 4) < REGISTER_COUNT && (bytes[1] & 0x0F) < REGISTER_COUNT;
+	}
+
+	// Format 3/4: n and i from the opcode byte, x b p e from the next half-byte
+	if (available < 3 || (bytes[0] & 0x03) == 0)
+	{
+		return false; // SIC instructions are not produced by the assembler
+	}
+	statement->flags = (bytes[0] & 0x03) << 4 | bytes[1] >> 4;
+	if (op->value == RSUB_VALUE)
+	{
+		statement->size = 3;
+		return bytes[0] == (RSUB_VALUE | 0x03) && bytes[1] == 0 && bytes[2] == 0;
+	}
+
+	if (statement->flags & FLAG_E)
+	{
+		int fieldAddress = statement->address + 1;
+		bool relocated = false;
+
+		if (available < 4 || (statement->flags & (FLAG_B | FLAG_P)))
+		{
+			return false;
+		}
+		statement->size = 4;
+		statement->value = (bytes[1] & 0x0F) << 16 | bytes[2] << 8 | bytes[3];
+
+		// A field changed by the loader names its external symbol or this section
+		for (int x = 0; x < program->modificationCount; x++)
+		{
+			if (program->modifications[x].address != fieldAddress)
+			{
+				continue;
+			}
+			for (int y = 0; y < program->referenceCount; y++)
+			{
+				if (strcmp(program->references[y].name, program->modifications[x].symbol) == 0)
+				{
+					strcpy(statement->external, program->modifications[x].symbol);
+					return statement->value == 0;
+				}
+			}
+			relocated = true;
+		}
+
+		// Immediate values stay numbers unless the loader relocates them
+		if (statement->value >= program->start && statement->value <= program->start + program->length &&
+			((statement->flags & (FLAG_N | FLAG_I)) != FLAG_I || relocated))
+		{
+			statement->target = statement->value;
+		}
+		return true;
+	}
+
+	statement->size = 3;
+	statement->value = (bytes[1] & 0x0F) << 8 | bytes[2];
+	if ((statement->flags & (FLAG_B | FLAG_P)) == (FLAG_B | FLAG_P))
+	{
+		return false;
+	}
+	if (statement->flags & FLAG_P)
+	{
+		statement->target = statement->address + 3 + ((statement->value ^ DISPLACEMENT_SIGN) - DISPLACEMENT_SIGN);
+	}
+	else if (statement->flags & FLAG_B)
+	{
+		if (base < 0)
+		{
+			return false;
+		}
+		statement->target = base + statement->value;
+	}
+	return statement->target < 0 || (statement->target >= program->start && statement->target <= program->start + program->length);
+}
+
+// Recovers the statements of a section from its memory image. Instructions are the bytes
+// reached by following control from the entry points of the section; a section without one is
+// swept linearly instead. Bytes no T record wrote become RESB, other bytes become BYTE
+// constants, and every operand target, symbol and external definition is given a label
+void decodeProgram(disassembly* code)
+{
+	objectProgram* program = code->program;
+	int* bases;
+	int base = -1;
+	int offset = 0;
+
+	code->statements = allocateMemory(sizeof(decodedStatement) * (program->length + 1));
+	code->statementCount = 0;
+	code->labels = allocateZeroedMemory(program->length + 1, sizeof(*code->labels));
+	bases = traceProgram(code);
+	if (bases != NULL)
+	{
+		nameLabels(code);
+	}
+
+	while (offset < program->length)
+	{
+		decodedStatement* statement = &code->statements[code->statementCount++];
+
+		if (!program->present[offset])
+		{
+			memset(statement, 0, sizeof(decodedStatement));
+			statement->address = program->start + offset;
+			statement->kind = STATEMENT_RESERVE;
+			statement->target = statement->base = -1;
+			while (offset + statement->size < program->length && !program->present[offset + statement->size])
+			{
+				statement->size++;
+			}
+		}
+		else if (bases != NULL ? bases[offset] == UNTRACED || !decodeInstruction(code, offset, bases[offset], statement) : !decodeInstruction(code, offset, base, statement))
+		{
+			// Constants run until a label, an instruction or a reservation
+			memset(statement, 0, sizeof(decodedStatement));
+			statement->address = program->start + offset;
+			statement->kind = STATEMENT_DATA;
+			statement->target = statement->base = -1;
+			do
+			{
+				statement->size++;
+			} while (bases != NULL && statement->size < MAX_DATA_BYTES && offset + statement->size < program->length &&
+				program->present[offset + statement->size] && bases[offset + statement->size] == UNTRACED && code->labels[offset + statement->size][0] == '\0');
+		}
+		else if (getLoadedBase(code, statement) >= 0)
+		{
+			// An immediate LDB is followed by the BASE directive for the loaded address, even
+			// when its operand stays a number
+			base = statement->base = getLoadedBase(code, statement);
+		}
+
+		if (bases == NULL && statement->target >= 0)
+		{
+			code->labels[statement->target - program->start][0] = ' ';
+		}
+		if (bases == NULL && statement->base >= 0)
+		{
+			code->labels[statement->base - program->start][0] = ' ';
+		}
+		offset += statement->size;
+	}
+	if (bases == NULL)
+	{
+		nameLabels(code);
+	}
+	releaseMemory(bases);
+}
+
+// Writes EXTDEF or EXTREF statements naming the provided symbols
+void emitExternalSymbols(listingText* listing, sourceLines* source, int address, char* directive, externalSymbol* symbols, int count)
+{
+	char operand[OPERAND_SIZE];
+
+	for (int x = 0; x < count; x += MAX_NAMES_PER_STATEMENT)
+	{
+		int length = 0;
+		for (int y = x; y < count && y < x + MAX_NAMES_PER_STATEMENT; y++)
+		{
+			length = appendField(operand, appendField(operand, length, y > x ? "," : "", 0), symbols[y].name, 0);
+		}
+		operand[length] = '\0';
+		emitStatement(listing, source, address, "", directive, operand, 0, 0);
+	}
+}
+
+// Writes the statements of one control section as listing text and as source lines
+void emitProgram(disassembly* code, bool last, char* entryLabel, listingText* listing, sourceLines* source)
+{
+	objectProgram* program = code->program;
+	char operand[OPERAND_SIZE];
+	char operation[SEGMENT_SIZE];
+
+	operand[appendHex(operand, 0, program->start, 0)] = '\0';
+	emitStatement(listing, source, program->start, program->name, code->section == 0 ? "START" : "CSECT", code->section == 0 ? operand : "", 0, 0);
+	emitExternalSymbols(listing, source, program->start, "EXTDEF", program->definitions, program->definitionCount);
+	emitExternalSymbols(listing, source, program->start, "EXTREF", program->references, program->referenceCount);
+
+	for (int x = 0; x < code->statementCount; x++)
+	{
+		decodedStatement* statement = &code->statements[x];
+		int offset = statement->address - program->start;
+		bool split = false;
+
+		if (statement->kind == STATEMENT_RESERVE)
+		{
+			// Labels inside a reservation split it into several RESB statements
+			int first = offset;
+			for (int y = offset + 1; y <= offset + statement->size; y++)
+			{
+				if (y == offset + statement->size || code->labels[y][0] != '\0')
+				{
+					operand[appendDecimal(operand, 0, y - first)] = '\0';
+					emitStatement(listing, source, program->start + first, code->labels[first], "RESB", operand, 0, 0);
+					first = y;
+				}
+			}
+			continue;
+		}
+
+		// A label inside an instruction is kept by writing the instruction as constants
+		for (int y = 1; statement->kind == STATEMENT_INSTRUCTION && y < statement->size; y++)
+		{
+			split |= code->labels[offset + y][0] != '\0';
+		}
+		if (statement->kind == STATEMENT_DATA && !split)
+		{
+			int length = appendField(operand, 0, "X'", 0);
+			unsigned int objectCode = 0;
+			for (int y = 0; y < statement->size; y++)
+			{
+				length = appendHex(operand, length, program->bytes[offset + y], 2);
+				objectCode = objectCode << 8 | program->bytes[offset + y];
+			}
+			operand[length] = '\'';
+			operand[length + 1] = '\0';
+			emitStatement(listing, source, statement->address, code->labels[offset], "BYTE", operand, objectCode, statement->size);
+		}
+		else if (split)
+		{
+			for (int y = 0; y < statement->size; y++)
+			{
+				int length = appendHex(operand, appendField(operand, 0, "X'", 0), program->bytes[offset + y], 2);
+				operand[length] = '\'';
+				operand[length + 1] = '\0';
+				emitStatement(listing, source, statement->address + y, code->labels[offset + y], "BYTE", operand, program->bytes[offset + y], 1);
+			}
+		}
+		else
+		{
+			unsigned int objectCode = 0;
+			for (int y = 0; y < statement->size; y++)
+			{
+				objectCode = objectCode << 8 | program->bytes[offset + y];
+			}
+			operation[appendField(operation, appendField(operation, 0, statement->size == 4 ? "+" : "", 0), statement->op->name, 0)] = '\0';
+			formatOperand(code, statement, operand);
+			emitStatement(listing, source, statement->address, code->labels[offset], operation, operand, objectCode, statement->size);
+		}
+		if (statement->base >= 0)
+		{
+			emitStatement(listing, source, statement->address + statement->size, "", "BASE", code->labels[statement->base - program->start], 0, 0);
+		}
+	}
+
+	if (last)
+	{
+		emitStatement(listing, source, program->start + program->length, code->labels[program->length], "END", entryLabel, 0, 0);
+	}
+}
+
+// Writes one statement as a listing line in the format of the assembler listing file and
+// adds it to the source lines used for reassembly
+void emitStatement(listingText* listing, sourceLines* source, int address, char* label, char* operation, char* operand, unsigned int objectCode, int objectBytes)
+{
+	char statement[LISTING_LINE_SIZE];
+	char hex[SEGMENT_SIZE];
+	char* line;
+	int length;
+
+	// Formatted by hand; printf() dominates the run time on large object files
+	if (source != NULL)
+	{
+		length = appendField(statement, 0, label, SEGMENT_SIZE - 1);
+		length = appendField(statement, length, operation, SEGMENT_SIZE - 1);
+		statement[appendField(statement, length, operand, 0)] = '\0';
+		appendSourceLine(source, statement);
+	}
+	if (listing == NULL)
+	{
+		return;
+	}
+
+	// The line is built in place at the end of the listing text
+	line = reserveListing(listing, LISTING_LINE_SIZE);
+	hex[appendHex(hex, 0, address, 0)] = '\0';
+	length = appendField(line, 0, hex, SEGMENT_SIZE - 1);
+	length = appendField(line, length, label, SEGMENT_SIZE - 1);
+	length = appendField(line, length, operation, SEGMENT_SIZE - 1);
+	length = appendField(line, length, operand, SEGMENT_SIZE - 1);
+	if (objectBytes > 0)
+	{
+		length = appendHex(line, appendField(line, length, "", 4), objectCode, objectBytes * 2);
+	}
+	line[length++] = '\n';
+	listing->size += length;
+}
+
+// Writes the listing text collected so far to its output file and empties the buffer
+// Text kept in memory (no output file) is left in place
+void flushListing(listingText* listing)
+{
+	if (listing->output != NULL && listing->size > 0)
+	{
+		fwrite(listing->text, 1, listing->size, listing->output);
+		listing->size = 0;
+	}
+}
+
+// Builds the operand of a decoded instruction from its flags, registers and target label
+void formatOperand(disassembly* code, decodedStatement* statement, char* operand)
+{
+	int flags = statement->flags & (FLAG_N | FLAG_I);
+	char* prefix = flags == FLAG_I ? "#" : flags == FLAG_N ? "@" : "";
+	char* index = statement->flags & FLAG_X ? ",X" : "";
+	int length;
+
+	if (statement->op->format == 1 || statement->op->value == RSUB_VALUE)
+	{
+		operand[0] = '\0';
+	}
+	else if (statement->op->format == 2)
+	{
+		// A second register of A is left out so single-register instructions read naturally
+		length = appendField(operand, 0, registerNames[statement->value >> 4], 0);
+		if ((statement->value & 0x0F) != 0)
+		{
+			length = appendField(operand, appendField(operand, length, ",", 0), registerNames[statement->value & 0x0F], 0);
+		}
+		operand[length] = '\0';
+	}
+	else if (strlen(statement->external) > 0)
+	{
+		operand[appendField(operand, appendField(operand, appendField(operand, 0, prefix, 0), statement->external, 0), index, 0)] = '\0';
+	}
+	else if (statement->target >= 0)
+	{
+		char* label = code->labels[statement->target - code->program->start];
+		operand[appendField(operand, appendField(operand, appendField(operand, 0, prefix, 0), label, 0), index, 0)] = '\0';
+	}
+	else
+	{
+		operand[appendField(operand, appendDecimal(operand, appendField(operand, 0, prefix, 0), statement->value), index, 0)] = '\0';
+	}
+}
+
+// Releases the object programs read by loadObjectFile()
+void freeObjectPrograms(objectProgram* programs, int count)
+{
+	for (int x = 0; x < count; x++)
+	{
+		releaseMemory(programs[x].bytes);
+		releaseMemory(programs[x].present);
+		releaseMemory(programs[x].definitions);
+		releaseMemory(programs[x].references);
+		releaseMemory(programs[x].modifications);
+	}
+	releaseMemory(programs);
+}
+
+// Returns the name an EXTDEF or the symbol file gives the address of the section; otherwise, NULL
+char* getKnownName(disassembly* code, int address)
+{
+	objectProgram* program = code->program;
+
+	for (int x = 0; x < program->definitionCount; x++)
+	{
+		if (program->definitions[x].address == address)
+		{
+			return program->definitions[x].name;
+		}
+	}
+	if (code->symbols != NULL)
+	{
+		symbolFileEntry* entry = lookupSymbolAddress(code->symbols, code->section, address);
+		if (entry != NULL && (int)entry->address == address)
+		{
+			return entry->name;
+		}
+	}
+	return NULL;
+}
+
+// Returns the address an immediate LDB loads into the base register, relocated or not, when it
+// lies in the section; otherwise, -1
+int getLoadedBase(disassembly* code, decodedStatement* statement)
+{
+	objectProgram* program = code->program;
+
+	if (statement->kind != STATEMENT_INSTRUCTION || strcmp(statement->op->name, "LDB") != 0 ||
+		(statement->flags & (FLAG_N | FLAG_I)) != FLAG_I || strlen(statement->external) > 0)
+	{
+		return -1;
+	}
+	if (statement->target >= 0)
+	{
+		return statement->target;
+	}
+	return statement->value >= program->start && statement->value <= program->start + program->length ? statement->value : -1;
+}
+
+// Releases the control sections read before a malformed object record
+// Returns -1
+int discardObjectPrograms(objectProgram** programs, int count)
+{
+	freeObjectPrograms(*programs, count);
+	*programs = NULL;
+	return -1;
+}
+
+// Disassembles one object file, adding its listing text to the listing. When verifying, the
+// listing is assembled again and the comparison of the memory images is described in result
+// Returns false if the file could not be read or did not verify; otherwise, true
+bool disassembleFile(char* filename, listingText* listing, bool verify, void (*assemble)(controlSection*, options*), char* result)
+{
+	objectProgram* programs;
+	int programCount = loadObjectFile(filename, &programs);
+	char* symFilename = createFilename(filename, ".sym");
+	sourceLines source = { NULL, 0, 0 };
+	symbolFile symbols;
+	bool hasSymbols = openSymbolFile(symFilename, &symbols);
+	char entryLabel[NAME_SIZE] = { '\0' };
+	disassembly* code;
+	bool matched = true;
+
+	releaseMemory(symFilename);
+	if (programCount <= 0)
+	{
+		if (hasSymbols)
+		{
+			closeSymbolFile(&symbols);
+		}
+		return false;
+	}
+
+	code = allocateZeroedMemory(programCount, sizeof(disassembly));
+	for (int x = 0; x < programCount; x++)
+	{
+		code[x].program = &programs[x];
+		code[x].section = x;
+		code[x].symbols = hasSymbols ? &symbols : NULL;
+	}
+	addExternalEntries(code, programCount);
+	for (int x = 0; x < programCount; x++)
+	{
+		decodeProgram(&code[x]);
+	}
+	if (programs[0].entry >= 0 && programs[0].entry - programs[0].start <= programs[0].length)
+	{
+		strcpy(entryLabel, code[0].labels[programs[0].entry - programs[0].start]);
+	}
+	for (int x = 0; x < programCount; x++)
+	{
+		emitProgram(&code[x], x == programCount - 1, entryLabel, verify ? NULL : listing, verify ? &source : NULL);
+	}
+	if (verify)
+	{
+		matched = verifyDisassembly(programs, programCount, &source, assemble, result);
+	}
+
+	for (int x = 0; x < programCount; x++)
+	{
+		releaseMemory(code[x].statements);
+		releaseMemory(code[x].labels);
+		releaseMemory(code[x].entries);
+	}
+	releaseMemory(code);
+	freeSourceLines(&source);
+	freeObjectPrograms(programs, programCount);
+	if (hasSymbols)
+	{
+		closeSymbolFile(&symbols);
+	}
+	return matched;
+}
+
+// Disassembles each object file to stdout as listing text. When verifying, the listing is
+// assembled again and the resulting memory images are compared with the originals instead.
+// Returns the number of files that could not be read or did not verify
+int disassembleFiles(char* filenames[], int count, bool verify, void (*assemble)(controlSection*, options*))
+{
+	listingText listing = { stdout, NULL, 0, 0 };
+	char result[RESULT_SIZE];
+	int failures = 0;
+
+	for (int x = 0; x < count; x++)
+	{
+		if (count > 1 && !verify)
+		{
+			char* header = reserveListing(&listing, strlen(filenames[x]) + 3);
+			int length = appendField(header, appendField(header, 0, x > 0 ? "\n" : "", 0), filenames[x], 0);
+			header[length++] = ':';
+			header[length++] = '\n';
+			listing.size += length;
+		}
+		result[0] = '\0';
+		if (!disassembleFile(filenames[x], &listing, verify, assemble, result))
+		{
+			failures++;
+		}
+		if (verify && result[0] != '\0')
+		{
+			printf("%s: %s\n", filenames[x], result);
+		}
+	}
+	flushListing(&listing);
+	releaseMemory(listing.text);
+	fflush(stdout);
+	return failures;
+}
+
+// Disassembles one object file into memory
+// Returns the listing text, released with releaseMemory(), and its size in size; NULL if the
+// file cannot be read
+char* disassembleToText(char* filename, size_t* size)
+{
+	listingText listing = { NULL, NULL, 0, 0 };
+
+	if (!disassembleFile(filename, &listing, false, NULL, NULL))
+	{
+		releaseMemory(listing.text);
+		return NULL;
+	}
+	*size = listing.size;
+	return listing.text;
+}
+
+// Maps an object file into memory and reads its control sections
+// Returns the number of control sections; -1 if the file cannot be read
+int loadObjectFile(char* filename, objectProgram** programs)
+{
+	struct stat status;
+	int descriptor = open(filename, O_RDONLY);
+	char* text;
+	int count;
+
+	if (descriptor < 0 || fstat(descriptor, &status) < 0 || status.st_size == 0)
+	{
+		displayError(FILE_NOT_FOUND, filename);
+		if (descriptor >= 0)
+		{
+			close(descriptor);
+		}
+		return -1;
+	}
+	text = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	close(descriptor);
+	if (text == MAP_FAILED)
+	{
+		displayError(FILE_NOT_FOUND, filename);
+		return -1;
+	}
+
+	count = readObjectText(text, status.st_size, programs);
+	munmap(text, status.st_size);
+	if (count <= 0)
+	{
+		displayError(ILLEGAL_OBJECT_RECORD, filename);
+	}
+	return count;
+}
+
+// Returns true if the statement is a Format 3/4 jump or subroutine call
+bool isJump(decodedStatement* statement)
+{
+	return statement->kind == STATEMENT_INSTRUCTION && statement->op->format == 3 && statement->op->name[0] == 'J';
+}
+
+// Names every labelled address: EXTDEF names first, then the symbol file, then a name made
+// from the address
+void nameLabels(disassembly* code)
+{
+	objectProgram* program = code->program;
+
+	for (int x = 0; x < program->definitionCount; x++)
+	{
+		if (program->definitions[x].address - program->start >= 0 && program->definitions[x].address - program->start <= program->length)
+		{
+			code->labels[program->definitions[x].address - program->start][0] = ' ';
+		}
+	}
+	if (code->symbols != NULL)
+	{
+		for (uint32_t x = 0; x < code->symbols->header->symbolCount; x++)
+		{
+			symbolFileEntry* entry = &code->symbols->symbols[x];
+			if ((int)entry->section == code->section && (int)entry->address - program->start >= 0 && (int)entry->address - program->start <= program->length)
+			{
+				code->labels[entry->address - program->start][0] = ' ';
+			}
+		}
+	}
+	if (program->entry - program->start >= 0 && program->entry - program->start <= program->length)
+	{
+		code->labels[program->entry - program->start][0] = ' ';
+	}
+
+	for (int x = 0; x <= program->length; x++)
+	{
+		if (code->labels[x][0] != '\0')
+		{
+			char* name = getKnownName(code, program->start + x);
+			if (name != NULL)
+			{
+				strcpy(code->labels[x], name);
+			}
+			else
+			{
+				snprintf(code->labels[x], NAME_SIZE, "L%05X", program->start + x);
+			}
+		}
+	}
+}
+
+// Returns the value of the hexadecimal digits at the start of the text; -1 if any is not a digit
+int parseHex(const char* text, int digits)
+{
+	int value = 0;
+
+	for (int x = 0; x < digits; x++)
+	{
+		int digit = hexDigits[(unsigned char)text[x]];
+		if (digit == 0)
+		{
+			return -1;
+		}
+		value = value << 4 | (digit - 1);
+	}
+	return value;
+}
+
+// Reads the H, D, R, T, M and E records of object code text into control sections
+// Returns the number of control sections; -1 if a record is malformed
+int readObjectText(const char* text, size_t size, objectProgram** programs)
+{
+	objectProgram* program = NULL;
+	int count = 0, capacity = 0;
+	size_t position = 0;
+
+	*programs = NULL;
+	while (position < size)
+	{
+		const char* line = &text[position];
+		const char* end = memchr(line, '\n', size - position);
+		int length = end != NULL ? end - line : (int)(size - position);
+
+		position += length + 1;
+		if (length > 0 && line[length - 1] == '\r')
+		{
+			length--;
+		}
+		if (length == 0)
+		{
+			continue;
+		}
+
+		if (line[0] == 'H')
+		{
+			if (length < 19)
+			{
+				return discardObjectPrograms(programs, count);
+			}
+			if (count == capacity)
+			{
+				capacity = capacity > 0 ? capacity * 2 : 4;
+				*programs = resizeMemory(*programs, sizeof(objectProgram) * capacity);
+			}
+			program = &(*programs)[count++];
+			memset(program, 0, sizeof(objectProgram));
+			memcpy(program->name, &line[1], NAME_SIZE - 1);
+			for (int x = NAME_SIZE - 2; x >= 0 && program->name[x] == ' '; x--)
+			{
+				program->name[x] = '\0';
+			}
+			program->start = parseHex(&line[7], 6);
+			program->length = parseHex(&line[13], 6);
+			program->entry = -1;
+			if (program->start < 0 || program->length < 0)
+			{
+				return discardObjectPrograms(programs, count);
+			}
+			program->bytes = allocateZeroedMemory(program->length + 1, 1);
+			program->present = allocateZeroedMemory(program->length + 1, sizeof(bool));
+			continue;
+		}
+		if (program == NULL)
+		{
+			return discardObjectPrograms(programs, count);
+		}
+
+		if (line[0] == 'T')
+		{
+			int address = parseHex(&line[1], 6);
+			int byteCount = parseHex(&line[7], 2);
+			if (address < 0 || byteCount < 0 || length < 9 + byteCount * 2)
+			{
+				return discardObjectPrograms(programs, count);
+			}
+			for (int x = 0; x < byteCount; x++)
+			{
+				int offset = address - program->start + x;
+				int value = parseHex(&line[9 + x * 2], 2);
+				if (value < 0)
+				{
+					return discardObjectPrograms(programs, count);
+				}
+				if (offset >= 0 && offset < program->length)
+				{
+					program->bytes[offset] = value;
+					program->present[offset] = true;
+				}
+			}
+		}
+		else if (line[0] == 'D' || line[0] == 'R')
+		{
+			// D records pair each name with an address; R records list names only
+			int width = line[0] == 'D' ? 12 : 6;
+			for (int x = 1; x < length; x += width)
+			{
+				externalSymbol symbol = { { '\0' }, 0 };
+				memcpy(symbol.name, &line[x], length - x < NAME_SIZE - 1 ? length - x : NAME_SIZE - 1);
+				for (int y = NAME_SIZE - 2; y >= 0 && (symbol.name[y] == ' ' || symbol.name[y] == '\0'); y--)
+				{
+					symbol.name[y] = '\0';
+				}
+				if (line[0] == 'D')
+				{
+					if (length < x + 12 || (symbol.address = parseHex(&line[x + 6], 6)) < 0)
+					{
+						return discardObjectPrograms(programs, count);
+					}
+					program->definitions = resizeMemory(program->definitions, sizeof(externalSymbol) * (program->definitionCount + 1));
+					program->definitions[program->definitionCount++] = symbol;
+				}
+				else if (strlen(symbol.name) > 0)
+				{
+					program->references = resizeMemory(program->references, sizeof(externalSymbol) * (program->referenceCount + 1));
+					program->references[program->referenceCount++] = symbol;
+				}
+			}
+		}
+		else if (line[0] == 'M')
+		{
+			modificationRecord record = { 0, 0, { '\0' } };
+			if (length < 10 || (record.address = parseHex(&line[1], 6)) < 0 || (record.length = parseHex(&line[7], 2)) < 0)
+			{
+				return discardObjectPrograms(programs, count);
+			}
+			if (length > 10)
+			{
+				memcpy(record.symbol, &line[10], length - 10 < NAME_SIZE - 1 ? length - 10 : NAME_SIZE - 1);
+			}
+			program->modifications = resizeMemory(program->modifications, sizeof(modificationRecord) * (program->modificationCount + 1));
+			program->modifications[program->modificationCount++] = record;
+		}
+		else if (line[0] == 'E')
+		{
+			program->entry = length >= 7 ? parseHex(&line[1], 6) : -1;
+			program = NULL;
+		}
+		else
+		{
+			return discardObjectPrograms(programs, count);
+		}
+	}
+	return count;
+}
+
+// Makes room for the provided number of bytes at the end of the listing text, writing the
+// text out first when it has an output file; otherwise, the buffer grows
+// Returns where the new text starts
+char* reserveListing(listingText* listing, size_t length)
+{
+	if (listing->size + length > listing->capacity)
+	{
+		flushListing(listing);
+	}
+	while (listing->size + length > listing->capacity)
+	{
+		listing->capacity = listing->capacity == 0 ? LISTING_BUFFER_SIZE : listing->capacity * 2;
+		listing->text = resizeMemory(listing->text, listing->capacity);
+	}
+	return &listing->text[listing->size];
+}
+
+// Follows control from the entry points of the section, marking the operand targets of the
+// instructions it reaches. Jumps through memory are not followed, and J and RSUB end a path
+// Returns the base register value at each instruction and UNTRACED for the other offsets;
+// NULL if the section has no entry points
+int* traceProgram(disassembly* code)
+{
+	objectProgram* program = code->program;
+	int* pending;
+	int pendingCount = 0;
+	int pendingSize = 2 * code->entryCount;
+	int* bases;
+
+	if (code->entryCount == 0)
+	{
+		return NULL;
+	}
+	bases = allocateMemory(sizeof(int) * program->length);
+	for (int x = 0; x < program->length; x++)
+	{
+		bases[x] = UNTRACED;
+	}
+
+	// Each pending path is an offset and the base register value on entry to it
+	pending = allocateMemory(sizeof(int) * pendingSize);
+	for (int x = 0; x < code->entryCount; x++)
+	{
+		pending[pendingCount++] = code->entries[x] - program->start;
+		pending[pendingCount++] = -1;
+	}
+
+	while (pendingCount > 0)
+	{
+		int base = pending[--pendingCount];
+		int offset = pending[--pendingCount];
+		decodedStatement statement;
+
+		while (offset >= 0 && offset < program->length && program->present[offset] && bases[offset] == UNTRACED &&
+			decodeInstruction(code, offset, base, &statement))
+		{
+			bases[offset] = base;
+			if (statement.target >= 0)
+			{
+				code->labels[statement.target - program->start][0] = ' ';
+			}
+			if (getLoadedBase(code, &statement) >= 0)
+			{
+				base = getLoadedBase(code, &statement);
+				code->labels[base - program->start][0] = ' ';
+			}
+			if (isJump(&statement) && statement.target >= 0 && (statement.flags & (FLAG_N | FLAG_I)) == (FLAG_N | FLAG_I))
+			{
+				if (pendingCount == pendingSize)
+				{
+					pendingSize *= 2;
+					pending = resizeMemory(pending, sizeof(int) * pendingSize);
+				}
+				pending[pendingCount++] = statement.target - program->start;
+				pending[pendingCount++] = base;
+			}
+			if (strcmp(statement.op->name, "J") == 0 || statement.op->value == RSUB_VALUE)
+			{
+				break;
+			}
+			offset += statement.size;
+		}
+	}
+	releaseMemory(pending);
+	return bases;
+}
+
+// Assembles the disassembled source lines and compares the memory image of each control
+// section with the object file it came from
+// Returns true if every section matches; otherwise, false, with the difference in result
+bool verifyDisassembly(objectProgram* programs, int count, sourceLines* source, void (*assemble)(controlSection*, options*), char* result)
+{
+	options settings = { .skipListing = true };
+	controlSection* sections;
+	objectProgram* rebuilt = NULL;
+	int sectionCount = splitControlSections(source, &sections);
+	int rebuiltCount = 0;
+	int byteCount = 0;
+	bool matched = true;
+
+	runControlSections(sections, sectionCount, &settings, assemble);
+	for (int x = 0; x < sectionCount && matched; x++)
+	{
+		objectProgram* section;
+		if (readObjectText(sections[x].objBuffer, sections[x].objSize, &section) != 1)
+		{
+			snprintf(result, RESULT_SIZE, "section %d did not reassemble", x + 1);
+			matched = false;
+			break;
+		}
+		rebuilt = resizeMemory(rebuilt, sizeof(objectProgram) * (rebuiltCount + 1));
+		rebuilt[rebuiltCount++] = *section;
+		releaseMemory(section);
+	}
+
+	if (matched && rebuiltCount != count)
+	{
+		snprintf(result, RESULT_SIZE, "%d sections reassembled from %d", rebuiltCount, count);
+		matched = false;
+	}
+	for (int x = 0; x < count && matched; x++)
+	{
+		if (rebuilt[x].start != programs[x].start || rebuilt[x].length != programs[x].length)
+		{
+			snprintf(result, RESULT_SIZE, "section %s spans 0x%X-0x%X after reassembly", programs[x].name, rebuilt[x].start, rebuilt[x].start + rebuilt[x].length);
+			matched = false;
+			break;
+		}
+		for (int y = 0; y < programs[x].length; y++)
+		{
+			if (rebuilt[x].present[y] != programs[x].present[y] || rebuilt[x].bytes[y] != programs[x].bytes[y])
+			{
+				snprintf(result, RESULT_SIZE, "mismatch in section %s at 0x%X", programs[x].name, programs[x].start + y);
+				matched = false;
+				break;
+			}
+			byteCount += programs[x].present[y];
+		}
+	}
+	if (matched)
+	{
+		snprintf(result, RESULT_SIZE, "verified %d bytes in %d sections", byteCount, count);
+	}
+
+	freeObjectPrograms(rebuilt, rebuiltCount);
+	freeControlSections(sections, sectionCount);
+	return matched;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+struct controlSection;
+
+// Used to store one control section read back from an object file
+typedef struct objectProgram
+{
+	char name[NAME_SIZE];
+	int start;
+	int length;
+	int entry;                       // Address named by the E record; -1 if none
+	unsigned char* bytes;            // Memory image of the section; length bytes
+	bool* present;                   // True for the bytes written by a T record
+	externalSymbol* definitions;     // D records
+	int definitionCount;
+	externalSymbol* references;      // R records
+	int referenceCount;
+	modificationRecord* modifications; // M records
+	int modificationCount;
+} objectProgram;
+
+// Used to store one statement recovered from the memory image
+typedef struct decodedStatement
+{
+	int address;
+	int size;
+	int kind;          // STATEMENT_INSTRUCTION, STATEMENT_DATA or STATEMENT_RESERVE
+	const opcode* op;  // Instructions only
+	int flags;         // nixbpe bits of Format 3/4 instructions
+	int value;         // Register byte, displacement or address field
+	int target;        // Address the operand names; -1 if the operand is a number
+	int base;          // Base register value set by an LDB instruction; -1 if none
+	char external[NAME_SIZE]; // External symbol added to the field by an M record
+} decodedStatement;
+
+int disassembleFiles(char* filenames[], int count, bool verify, void (*assemble)(struct controlSection*, options*));
+char* disassembleToText(char* filename, size_t* size);
+void freeObjectPrograms(objectProgram* programs, int count);
+int loadObjectFile(char* filename, objectProgram** programs);
@@ -1,57 +1,174 @@
 #include "headers.h"
 
-// Displays the specified error along with the provided error information
+// Set by a thread that assembles many files, so an error in one file is recorded and returns to
+// the thread instead of ending the process
+static __thread jmp_buf* errorRecovery = NULL;
+static __thread char* errorMessage = NULL;
+static __thread size_t errorMessageSize = 0;
+static __thread errorCleanup* errorCleanups = NULL; // Innermost first
+
+// Displays the specified error along with the provided error information. Once the thread has
+// called recoverFromErrors(), the message is recorded instead, the registered cleanups release
+// what the functions being left hold, and the thread jumps back to its recovery point; running
+// out of memory still ends the process
 void displayError(int errorType, char* errorInfo)
 {
+	bool recovering = errorRecovery != NULL && errorType != MEMORY_LIMIT_EXCEEDED;
+	FILE* output = recovering ? fmemopen(errorMessage, errorMessageSize, "w") : stdout;
+
+	if (output == NULL)
+	{
+		output = stdout;
+	}
+
 	// Determine which error message to display
 	switch (errorType)
 	{
 		// Pass 1 errors
 		// Blank line found
 		case BLANK_RECORD:
-			printf("ERROR: Source File Contains Blank Lines.\n");
+			fprintf(output, "ERROR: Source File Contains Blank Lines.\n");
 			break;
 		// The symbol name already exists in the Symbol Table
 		case DUPLICATE:
-			printf("ERROR: Duplicate Symbol Name (%s) Found in Source File.\n", errorInfo);
+			fprintf(output, "ERROR: Duplicate Symbol Name (%s) Found in Source File.\n", errorInfo);
 			break;
 		// The provided file was not found
 		case FILE_NOT_FOUND: 
-			printf("FATAL ERROR: File Not Found (%s).\n", errorInfo);
+			fprintf(output, "FATAL ERROR: File Not Found (%s).\n", errorInfo);
+			break;
+		// An INCLUDE directive is malformed or includes a file that is already being included
+		case ILLEGAL_INCLUDE:
+			fprintf(output, "ERROR: Illegal Include (%s) Found in Source File.\n", errorInfo);
+			break;
+		// A MACRO definition is malformed, nested or missing its MEND statement
+		case ILLEGAL_MACRO_DEFINITION:
+			fprintf(output, "ERROR: Illegal Macro Definition (%s) Found in Source File.\n", errorInfo);
+			break;
+		// A macro invocation has too many arguments, a conflicting label, expands too deeply or
+		// substitutes an argument that makes a statement longer than a source line
+		case ILLEGAL_MACRO_INVOCATION:
+			fprintf(output, "ERROR: Illegal Macro Invocation (%s) Found in Source File.\n", errorInfo);
 			break;
 		// An unknown opcode or directive name exists in the Operation segment of an instruction
 		case ILLEGAL_OPCODE_DIRECTIVE:
-			printf("ERROR: Illegal Opcode or Directive (%s) Found in Source File.\n", errorInfo);
+			fprintf(output, "ERROR: Illegal Opcode or Directive (%s) Found in Source File.\n", errorInfo);
 			break;
 		// An opcode or directive name exists in the Label segment of an instruction
 		case ILLEGAL_SYMBOL:
-			printf("ERROR: Symbol Name (%s) Cannot be a Command or Directive.\n", errorInfo);
+			fprintf(output, "ERROR: Symbol Name (%s) Cannot be a Command or Directive.\n", errorInfo);
+			break;
+		// An allocation would exceed the memory limit, or the host has no memory left
+		case MEMORY_LIMIT_EXCEEDED:
+			fprintf(output, "FATAL ERROR: Memory Limit Exceeded Allocating %s Bytes.\n", errorInfo);
 			break;
 		// The input filename was not provided as a command-line argument
 		case MISSING_COMMAND_LINE_ARGUMENTS: 
-			printf("Usage: %s inputFile\n", errorInfo);
+			fprintf(output, "Usage: %s [-bBnOqrwx] [-C dir] [--cache-size=MB] [--listing-map] [--jobs=N] [--memory-limit=MB] [--memory-stats] inputFile\n"
+				"       %s --cache-stats [-C dir]\n"
+				"       %s -d [-V] objectFile...\n"
+				"       %s -p [--max-steps=N] objectFile...\n"
+				"       %s --batch [--jobs=N] [--max-steps=N] objectFile...\n"
+				"       %s --regress [--golden=dir] [--baseline=file] [--timings=file] [--jobs=N] [-bBnOrx] sourceFile|directory...\n"
+				"       %s --rebuild-listing sourceFile...\n"
+				"  -b, --base-analysis      report the BASE regions       -B, --insert-base        also insert LDB/BASE pairs\n"
+				"  -n, --no-listing         skip the listing              -O, --optimize           choose Format 3 or 4\n"
+				"  -q, --quiet              leave the summary off stdout  -r, --cross-reference    list symbol references\n"
+				"  -w, --watch              reassemble on each save       -x, --extended-records   write longer T records\n"
+				"  -C, --cache=dir          cache the outputs in dir      -d, --disassemble        list object files\n"
+				"  -V, --verify             disassemble and reassemble    -p, --profile            simulate and profile\n"
+				"  --listing-map            write a .lmap, not a .lst     --rebuild-listing        write the .lst from a .lmap\n",
+				errorInfo, errorInfo, errorInfo, errorInfo, errorInfo, errorInfo, errorInfo);
 			break;
 		// The current memory value exceeds the maximum SIC/XE memory (0x100000)
 		case OUT_OF_MEMORY:
-			printf("ERROR: Program Address (%s) Exceeds Maximum Memory Address [0x100000].\n", errorInfo);
+			fprintf(output, "ERROR: Program Address (%s) Exceeds Maximum Memory Address [0x100000].\n", errorInfo);
 			break;
 		// The specified BYTE value exceeds the valid range of 00 to FF
 		case OUT_OF_RANGE_BYTE:
-			printf("ERROR: Byte Value (%s) Out of Range [00 to FF].\n", errorInfo);
+			fprintf(output, "ERROR: Byte Value (%s) Out of Range [00 to FF].\n", errorInfo);
+			break;
+		// The specified WORD value is not a number that fits in 24 bits
+		case OUT_OF_RANGE_WORD:
+			fprintf(output, "ERROR: Word Value (%s) Out of Range [-8,388,608 to 16,777,215].\n", errorInfo);
 			break;
 		
 		// Pass 2 errors
 		// Format 3 opcode, but PC- and BASE-relative addressing is out of range
 		case ADDRESS_OUT_OF_RANGE: 
-			printf("ERROR: Format 3 Opcode (%s) Address Displacement Out of Range [-2,048 to 4,096].\n", errorInfo);
+			fprintf(output, "ERROR: Format 3 Opcode (%s) Address Displacement Out of Range [-2,048 to 4,095].\n", errorInfo);
+			break;
+		// An EXTREF symbol is used by other than a Format 4 instruction
+		case ILLEGAL_EXTERNAL_REFERENCE:
+			fprintf(output, "ERROR: External Symbol (%s) Requires a Format 4 Instruction.\n", errorInfo);
 			break;
 		// Format 4 is indicated for a Format 1 or Format 2 opcode
 		case ILLEGAL_OPCODE_FORMAT: 
-			printf("ERROR: Format 4 Indicated (%s) for Other Than Format 3 Opcode.\n", errorInfo);
+			fprintf(output, "ERROR: Format 4 Indicated (%s) for Other Than Format 3 Opcode.\n", errorInfo);
 			break;
 		// The specified operand name is not found in the Symbol Table
 		case UNKNOWN_SYMBOL: 
-			printf("ERROR: Unknown Operand Symbol (%s).\n", errorInfo);
+			fprintf(output, "ERROR: Unknown Operand Symbol (%s).\n", errorInfo);
+			break;
+		
+		// Disassembler errors
+		// An object file record is malformed or precedes the H record
+		case ILLEGAL_OBJECT_RECORD:
+			fprintf(output, "ERROR: Illegal Object Record Found in Object File (%s).\n", errorInfo);
+			break;
+
+		// Listing map errors
+		// A listing map does not match its source or object file
+		case STALE_LISTING_MAP:
+			fprintf(output, "ERROR: Listing Map (%s) Does Not Match Its Source or Object File.\n", errorInfo);
 			break;
 	}
+
+	if (recovering)
+	{
+		if (output != stdout)
+		{
+			fclose(output);
+		}
+		while (errorCleanups != NULL)
+		{
+			errorCleanup* cleanup = errorCleanups;
+			errorCleanups = cleanup->next;
+			cleanup->release(cleanup->data);
+		}
+		longjmp(*errorRecovery, 1);
+	}
+}
+
+// Removes the cleanup registered last by pushErrorCleanup(), once its data has been released
+// or handed on
+void popErrorCleanup(errorCleanup* cleanup)
+{
+	if (errorCleanups == cleanup)
+	{
+		errorCleanups = cleanup->next;
+	}
+}
+
+// Registers a function that releases the data if an error recovers past the caller. Outside
+// error recovery an error ends the process, so nothing is recorded
+void pushErrorCleanup(errorCleanup* cleanup, void (*release)(void* data), void* data)
+{
+	cleanup->release = release;
+	cleanup->data = data;
+	cleanup->next = errorCleanups;
+	if (errorRecovery != NULL)
+	{
+		errorCleanups = cleanup;
+	}
+}
+
+// Makes the errors of the calling thread jump to the recovery point with their message in the
+// provided buffer instead of ending the process; NULL restores the default
+void recoverFromErrors(jmp_buf* recovery, char* message, size_t size)
+{
+	errorRecovery = recovery;
+	errorMessage = message;
+	errorMessageSize = size;
+	errorCleanups = NULL;
 }
\ No newline at end of file
@@ -13,13 +13,32 @@
 // List of possible errors
 enum errors {
 	// Pass 1 errors
-	BLANK_RECORD = 1, DUPLICATE, FILE_NOT_FOUND, ILLEGAL_OPCODE_DIRECTIVE, ILLEGAL_SYMBOL, 
-	MISSING_COMMAND_LINE_ARGUMENTS, OUT_OF_MEMORY, OUT_OF_RANGE_BYTE, OUT_OF_RANGE_WORD, 
+	BLANK_RECORD = 1, DUPLICATE, FILE_NOT_FOUND, ILLEGAL_INCLUDE, ILLEGAL_MACRO_DEFINITION, ILLEGAL_MACRO_INVOCATION, ILLEGAL_OPCODE_DIRECTIVE, ILLEGAL_SYMBOL, 
+	MEMORY_LIMIT_EXCEEDED, MISSING_COMMAND_LINE_ARGUMENTS, OUT_OF_MEMORY, OUT_OF_RANGE_BYTE, OUT_OF_RANGE_WORD, 
 	
 	// Pass 2 errors
 	ADDRESS_OUT_OF_RANGE,  // Format 3 opcode, but PC- and BASE-relative addressing is out of range
+	ILLEGAL_EXTERNAL_REFERENCE, // An EXTREF symbol is used by other than a Format 4 instruction
 	ILLEGAL_OPCODE_FORMAT, // Format 4 is indicated for a Format 1 or Format 2 opcode
-	UNKNOWN_SYMBOL         // The specified operand name is not found in the Symbol Table
+	UNKNOWN_SYMBOL,        // The specified operand name is not found in the Symbol Table
+
+	// Disassembler errors
+	ILLEGAL_OBJECT_RECORD, // An object file record is malformed or precedes the H record
+
+	// Listing map errors
+	STALE_LISTING_MAP      // A listing map does not match its source or object file
 };
 
-void displayError(int errorType, char* errorInfo);
\ No newline at end of file
+// Used to release what a function holds if an error recovers past it. The entry lives in the
+// function's own frame and links to the entry of the function that called it
+typedef struct errorCleanup
+{
+	void (*release)(void* data);
+	void* data;
+	struct errorCleanup* next;
+} errorCleanup;
+
+void displayError(int errorType, char* errorInfo);
+void popErrorCleanup(errorCleanup* cleanup);
+void pushErrorCleanup(errorCleanup* cleanup, void (*release)(void* data), void* data);
+void recoverFromErrors(jmp_buf* recovery, char* message, size_t size);
\ No newline at end of file
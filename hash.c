@@ -0,0 +1,16 @@
+#include "headers.h"
+
+#define FNV32_PRIME 16777619u
+
+// Adds the bytes to a 32-bit FNV-1a hash; a new hash starts from FNV32_OFFSET_BASIS
+// Returns the updated hash
+uint32_t hashBytes(uint32_t hash, const void* bytes, size_t size)
+{
+	const unsigned char* next = bytes;
+
+	for (size_t x = 0; x < size; x++)
+	{
+		hash = (hash ^ next[x]) * FNV32_PRIME;
+	}
+	return hash;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+#define FNV32_OFFSET_BASIS 2166136261u
+
+uint32_t hashBytes(uint32_t hash, const void* bytes, size_t size);
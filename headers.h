@@ -15,12 +15,26 @@
 #include <stdbool.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <setjmp.h>
 
+#define ASSEMBLER_VERSION "2.0"
+#define BASE_MAX_RANGE 4095
+#define INPUT_BUF_SIZE 60
+#define MAX_EXTENDED_RECORD_BYTE_COUNT 255
 #define NAME_SIZE 7
+#define OPERAND_SIZE INPUT_BUF_SIZE
+#define PC_MAX_RANGE 2047
+#define PC_MIN_RANGE -2048
 #define SEGMENT_SIZE 9
 
 #include "directives.h"
 #include "errors.h"
+#include "memory.h"
+#include "hash.h"
+#include "source.h"
+#include "macros.h"
+#include "include.h"
 #include "opcodes.h"
 #include "symbols.h"
 
@@ -32,6 +46,7 @@ typedef struct address
 	int current;
 	int increment;
 	int base;
+	int end;
 } address;
 
 // Used for managing the various segments of a SIC/XE instruction
@@ -42,32 +57,106 @@ typedef struct segment
 	// CLOOP   JSUB        RDREC
 	char label[SEGMENT_SIZE];
 	char operation[SEGMENT_SIZE];
-	char operand[SEGMENT_SIZE];
+	char operand[OPERAND_SIZE];
 } segment;
 
+segment* prepareSegments(char* line, segment* segments);
+
 // Pass 2 structures
-// Used to store Text Record entries for the Object Code file 
-typedef struct recordEntry
+// Used to store an external symbol named by an EXTDEF or EXTREF directive
+typedef struct externalSymbol
+{
+	char name[NAME_SIZE];
+	int address; // Defined address; D records only
+} externalSymbol;
+
+// Used to store the field an M record asks the loader to modify
+typedef struct modificationRecord
 {
+	int address;
+	int length;             // Half-bytes to modify
+	char symbol[NAME_SIZE]; // Control section or external symbol added to the field
+} modificationRecord;
+
+// Used to store the bytes of an instruction or constant until T records are written in address order
+typedef struct textFragment
+{
+	int address;
+	int offset;   // Position of the bytes in the fragment byte pool
 	int numBytes;
-	int value;
-} recordEntry;
+	int order; // Position in the source; keeps the sort stable
+} textFragment;
 
 // Used to store important data for the Object Code file
 typedef struct objectFileData
 {
-	int modificationCount;         // M records
-	int modificationEntries[60];   // M records
+	externalSymbol* externalSymbols;         // D and R records
+	int externalSymbolCount;                 // D and R records
+	int fragmentByteCapacity;                // T records
+	int fragmentByteCount;                   // T records
+	unsigned char* fragmentBytes;            // T records: bytes of every fragment, in source order
+	int fragmentCapacity;                    // T records
+	int fragmentCount;                       // T records
+	textFragment* fragments;                 // T records
+	int modificationCapacity;                // M records
+	int modificationCount;                   // M records
+	modificationRecord* modificationEntries; // M records
 	char programName[NAME_SIZE];   // H and M records
 	int programSize;               // H record
 	int recordAddress;             // T records
 	int recordByteCount;           // T records
-	recordEntry recordEntries[60]; // Store T record data
-	int recordEntryCount;          // T records
+	unsigned char recordBytes[MAX_EXTENDED_RECORD_BYTE_COUNT]; // Store T record data
+	int recordLimit;               // T records: bytes written before a record is closed
 	char recordType;               // H, T, E or M
 	int startAddress;              // H and E records
 } objectFileData;
 
+// Command-line structures
+// Used to store the options selected on the command line
+typedef struct options
+{
+	bool analyzeBases;    // Report the BASE regions that reach out-of-range references
+	char* baselineFile;   // Timings of an earlier regression run to compare with; NULL if none
+	bool batch;           // Run object files to completion on a thread pool and report each run
+	char* cacheDirectory; // Directory of the output cache; NULL if caching is off
+	long cacheLimit;      // Size limit of the output cache in bytes
+	bool cacheStatistics; // Report the hits, misses and size of the output cache
+	bool crossReference;  // End the listing of each control section with a cross-reference
+	bool disassemble;     // Disassemble object files instead of assembling a source file
+	bool extendedRecords; // Write T records of up to 255 bytes for loaders that accept them
+	char* goldenDirectory; // Directory of the golden outputs of a regression run; NULL for next to each source
+	bool insertBases;     // Insert LDB/BASE pairs for the suggested BASE regions
+	int jobs;             // Threads of a run or of the control sections; zero for one per processor
+	bool listingMap;      // Write a listing map instead of the listing, for --rebuild-listing
+	long maxSteps;        // Instructions the simulator executes before it stops a program
+	size_t memoryLimit;   // Bytes the assembler may hold at once; zero if unlimited
+	bool memoryStatistics; // Report the memory used by each assembly
+	bool optimizeFormats; // Choose Format 3 or Format 4 for unmarked instructions
+	bool profile;         // Simulate object files and report the instructions executed most
+	bool quiet;           // Leave the symbol table and summary off stdout
+	bool rebuildListing;  // Rebuild the listing of source files from their listing maps
+	bool regress;         // Assemble source files in memory and compare the outputs with golden files
+	bool skipListing;     // Leave the listing file unwritten and skip formatting it
+	char* timingFile;     // File a regression run writes the time of each file to; NULL if none
+	bool verify;          // Reassemble the disassembly and compare it with the object file
+	bool watch;           // Reassemble the source file each time it changes
+} options;
+
+#include "names.h"
+#include "relax.h"
+#include "bases.h"
+#include "blocks.h"
+#include "lstmap.h"
+#include "sections.h"
+#include "symfile.h"
+#include "disasm.h"
+#include "cache.h"
+#include "watch.h"
+#include "writer.h"
+#include "pages.h"
+#include "sim.h"
+#include "regress.h"
+
 
 
 
@@ -0,0 +1,264 @@
+#include "headers.h"
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define COMMENT '#'
+#define INITIAL_INCLUDE_CAPACITY 8
+
+// Used to store one file of the include cache with the modification time and size it had when
+// it was read, so a file shared by many programs is read and split once until it is modified
+// or evicted
+typedef struct includedFile
+{
+	struct timespec modified;
+	off_t size;
+	unsigned long used; // Value of includeClock when the file was last returned
+	parsedFile* file;
+} includedFile;
+
+static includedFile* includeCache = NULL;
+static int includeCount = 0;
+static int includeCapacity = 0;
+static size_t includeBytes = 0;      // Bytes held by the cached files
+static unsigned long includeClock = 0; // Counts the files returned, to order them by use
+static void (*includeReport)(char*, void*) = NULL;
+static void* includeReportContext = NULL;
+static pthread_mutex_t includeLock = PTHREAD_MUTEX_INITIALIZER; // Held while the cache or a reference count changes
+
+void dropIncludedFile(parsedFile* file);
+void evictIncludedFiles(size_t limit);
+parsedFile* loadParsedFile(char* path);
+void parseIncludedFile(parsedFile* file);
+
+// Removes one reference to the file, freeing it when none are left; the lock must be held
+void dropIncludedFile(parsedFile* file)
+{
+	if (--file->references > 0)
+	{
+		return;
+	}
+	for (int x = 0; x < file->includeCount; x++)
+	{
+		releaseMemory(file->includes[x]);
+	}
+	releaseMemory(file->includes);
+	releaseMemory(file->statements);
+	freeSourceLines(&file->lines);
+	releaseMemory(file->path);
+	releaseMemory(file);
+}
+
+// Removes the least recently used files from the cache until the files it holds fit the limit.
+// A file still used by an assembly is freed when that assembly releases it; the lock must be held
+void evictIncludedFiles(size_t limit)
+{
+	while (includeBytes > limit && includeCount > 0)
+	{
+		int oldest = 0;
+		for (int x = 1; x < includeCount; x++)
+		{
+			if (includeCache[x].used < includeCache[oldest].used)
+			{
+				oldest = x;
+			}
+		}
+		includeBytes -= includeCache[oldest].file->size;
+		dropIncludedFile(includeCache[oldest].file);
+		includeCache[oldest] = includeCache[--includeCount];
+	}
+	if (includeCount == 0)
+	{
+		releaseMemory(includeCache);
+		includeCache = NULL;
+		includeCapacity = 0;
+	}
+}
+
+// Reads a source file and splits it into statements
+// Returns the file with one reference held by the caller; NULL if the file cannot be read
+parsedFile* loadParsedFile(char* path)
+{
+	char line[INPUT_BUF_SIZE];
+	parsedFile* file;
+	errorCleanup cleanup;
+	FILE* input = fopen(path, "r");
+
+	if (input == NULL)
+	{
+		return NULL;
+	}
+	file = allocateZeroedMemory(1, sizeof(parsedFile));
+	file->path = duplicateString(path);
+	file->references = 1;
+	while (fgets(line, INPUT_BUF_SIZE, input))
+	{
+		appendSourceLine(&file->lines, line);
+	}
+	fclose(input);
+	pushErrorCleanup(&cleanup, releaseIncludedFileCleanup, file);
+	parseIncludedFile(file);
+	popErrorCleanup(&cleanup);
+	file->size = sizeof(parsedFile) + (size_t)file->lines.capacity * INPUT_BUF_SIZE + (size_t)(file->lines.count + 1) * sizeof(sourceStatement);
+	for (int x = 0; x < file->includeCount; x++)
+	{
+		file->size += strlen(file->includes[x]) + 1;
+	}
+	return file;
+}
+
+// Splits each statement of the file into its columns and resolves the files its INCLUDE
+// directives name. An INCLUDE directive that is not valid is reported here
+void parseIncludedFile(parsedFile* file)
+{
+	char included[PATH_MAX];
+	int capacity = 0;
+
+	file->statements = allocateZeroedMemory(file->lines.count + 1, sizeof(sourceStatement));
+	for (int x = 0; x < file->lines.count; x++)
+	{
+		char* line = file->lines.lines[x];
+		sourceStatement* statement = &file->statements[x];
+
+		statement->include = -1;
+		if (getIncludeFilename(line, file->path, included))
+		{
+			if (file->includeCount == capacity)
+			{
+				capacity = capacity > 0 ? capacity * 2 : INITIAL_INCLUDE_CAPACITY;
+				file->includes = resizeMemory(file->includes, sizeof(char*) * capacity);
+			}
+			file->includes[file->includeCount] = duplicateString(included);
+			statement->include = file->includeCount++;
+		}
+		else if (line[0] != COMMENT && line[0] >= ' ')
+		{
+			splitStatement(line, statement->label, statement->operation, statement->operand);
+		}
+	}
+}
+
+// Returns the statements of a file named by an INCLUDE directive, reading and splitting it
+// only when it is not cached or has been modified since it was cached. Threads assembling
+// different files share the cache, which keeps the most recently used files up to
+// INCLUDE_CACHE_LIMIT bytes. The caller holds a reference to the file until it calls
+// releaseIncludedFile(), so a newer copy read by another thread or an eviction never frees
+// the statements in use
+// Returns NULL if the file cannot be read
+parsedFile* readIncludedFile(char* filename)
+{
+	char resolved[PATH_MAX];
+	includedFile* entry = NULL;
+	parsedFile* file = NULL;
+	struct stat status;
+
+	if (realpath(filename, resolved) == NULL || stat(resolved, &status) != 0)
+	{
+		return NULL;
+	}
+	pthread_mutex_lock(&includeLock);
+	if (includeReport != NULL)
+	{
+		includeReport(resolved, includeReportContext);
+	}
+	for (int x = 0; x < includeCount && file == NULL; x++)
+	{
+		entry = &includeCache[x];
+		if (strcmp(entry->file->path, resolved) == 0 && entry->size == status.st_size &&
+			entry->modified.tv_sec == status.st_mtim.tv_sec && entry->modified.tv_nsec == status.st_mtim.tv_nsec)
+		{
+			entry->used = ++includeClock;
+			file = entry->file;
+			file->references++;
+		}
+	}
+	pthread_mutex_unlock(&includeLock);
+	if (file != NULL)
+	{
+		return file;
+	}
+
+	// The file is read and split without the lock, so an error in it cannot leave the lock held
+	if ((file = loadParsedFile(resolved)) == NULL)
+	{
+		return NULL;
+	}
+
+	pthread_mutex_lock(&includeLock);
+	entry = NULL;
+	for (int x = 0; x < includeCount && entry == NULL; x++)
+	{
+		if (strcmp(includeCache[x].file->path, resolved) == 0)
+		{
+			entry = &includeCache[x];
+			includeBytes -= entry->file->size;
+			dropIncludedFile(entry->file);
+		}
+	}
+	if (entry == NULL)
+	{
+		if (includeCount == includeCapacity)
+		{
+			includeCapacity = includeCapacity > 0 ? includeCapacity * 2 : INITIAL_INCLUDE_CAPACITY;
+			includeCache = resizeMemory(includeCache, sizeof(includedFile) * includeCapacity);
+		}
+		entry = &includeCache[includeCount++];
+	}
+	entry->modified = status.st_mtim;
+	entry->size = status.st_size;
+	entry->used = ++includeClock;
+	entry->file = file;
+	file->references++;
+	includeBytes += file->size;
+	evictIncludedFiles(INCLUDE_CACHE_LIMIT);
+	pthread_mutex_unlock(&includeLock);
+	return file;
+}
+
+// Reads and splits the main source file of a program without caching it, since no other
+// program reads it
+// Returns the file, released with releaseIncludedFile(); NULL if the file cannot be read
+parsedFile* readParsedFile(char* filename)
+{
+	char resolved[PATH_MAX];
+
+	if (realpath(filename, resolved) == NULL)
+	{
+		return NULL;
+	}
+	return loadParsedFile(resolved);
+}
+
+// Releases the reference to a file returned by readIncludedFile()
+void releaseIncludedFile(parsedFile* file)
+{
+	pthread_mutex_lock(&includeLock);
+	dropIncludedFile(file);
+	pthread_mutex_unlock(&includeLock);
+}
+
+// Releases a file reference registered with pushErrorCleanup()
+void releaseIncludedFileCleanup(void* file)
+{
+	releaseIncludedFile(file);
+}
+
+// Passes the path of every file read from now on to the report function, so watch mode can
+// follow the files a program includes; NULL stops the report
+void reportIncludedFiles(void (*report)(char* path, void* context), void* context)
+{
+	pthread_mutex_lock(&includeLock);
+	includeReport = report;
+	includeReportContext = context;
+	pthread_mutex_unlock(&includeLock);
+}
+
+// Removes the least recently used files from the include cache until the files it holds fit
+// the limit in bytes; zero empties the cache
+void trimIncludeCache(size_t limit)
+{
+	pthread_mutex_lock(&includeLock);
+	evictIncludedFiles(limit);
+	pthread_mutex_unlock(&includeLock);
+}
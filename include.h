@@ -0,0 +1,24 @@
+#pragma once
+
+#define INCLUDE_CACHE_LIMIT (16L * 1024 * 1024)
+#define MAX_INCLUDE_DEPTH 16
+
+// Used to store a file read for an INCLUDE directive with its statements split into columns.
+// The include cache and every program reading the file share it; the last to release it frees it
+typedef struct parsedFile
+{
+	char* path;                  // Path returned by realpath()
+	int references;
+	sourceLines lines;           // Statements before macro processing
+	sourceStatement* statements; // Columns of each statement
+	char** includes;             // Files named by the INCLUDE directives of the file
+	int includeCount;
+	size_t size;                 // Bytes held by the file, charged to the include cache
+} parsedFile;
+
+parsedFile* readIncludedFile(char* filename);
+parsedFile* readParsedFile(char* filename);
+void releaseIncludedFile(parsedFile* file);
+void releaseIncludedFileCleanup(void* file);
+void reportIncludedFiles(void (*report)(char* path, void* context), void* context);
+void trimIncludeCache(size_t limit);
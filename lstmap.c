@@ -0,0 +1,284 @@
+#include "headers.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define INITIAL_MAP_CAPACITY 256
+#define LISTING_MAP_LINE_MASK 0x3FFFFFFFu
+#define NEW_LINE '\n'
+
+uint32_t hashSourceLines(sourceLines* source);
+int rebuildListing(char* filename, void (*format)(FILE*, int, char*, unsigned char*, int));
+
+// Records a listed statement of the section: its line in the section, its address, and the
+// number of object code bytes the listing shows for it
+void addListingMapEntry(controlSection* section, int line, int address, int size)
+{
+	if (section->mapCount == section->mapCapacity)
+	{
+		section->mapCapacity = section->mapCapacity > 0 ? section->mapCapacity * 2 : INITIAL_MAP_CAPACITY;
+		section->mapEntries = resizeMemory(section->mapEntries, sizeof(listingMapEntry) * section->mapCapacity);
+	}
+	section->mapEntries[section->mapCount].line = line;
+	section->mapEntries[section->mapCount++].location = ((uint32_t)address << 8) | (size & 0xFF);
+}
+
+// Computes the 32-bit FNV-1a hash of the statements, each with its terminating NUL, so a listing
+// map is only applied to the source it was written for
+uint32_t hashSourceLines(sourceLines* source)
+{
+	uint32_t hash = FNV32_OFFSET_BASIS;
+
+	for (int x = 0; x < source->count; x++)
+	{
+		hash = hashBytes(hash, source->lines[x], strnlen(source->lines[x], INPUT_BUF_SIZE - 1) + 1);
+	}
+	return hash;
+}
+
+// Rebuilds the listing of one source file from the statements of the source, the listing map
+// and the object code of the object file, formatting each statement with the provided function
+// Returns zero if the listing was written; otherwise, -1
+int rebuildListing(char* filename, void (*format)(FILE*, int, char*, unsigned char*, int))
+{
+	char* mapFilename = createFilename(filename, ".lmap");
+	char* objFilename = createFilename(filename, ".obj");
+	char* lstFilename = createFilename(filename, ".lst");
+	sourceLines source = { NULL, 0, 0 };
+	objectProgram* programs = NULL;
+	int programCount = 0;
+	listingMapHeader* header = NULL;
+	void* map = MAP_FAILED;
+	size_t mapSize = 0;
+	char* text = NULL;
+	size_t size = 0;
+	bool matched = false;
+	struct stat status;
+	int descriptor = open(mapFilename, O_RDONLY);
+
+	if (descriptor < 0)
+	{
+		displayError(FILE_NOT_FOUND, mapFilename);
+		releaseMemory(mapFilename);
+		releaseMemory(objFilename);
+		releaseMemory(lstFilename);
+		return -1;
+	}
+	if (fstat(descriptor, &status) == 0 && (size_t)status.st_size >= sizeof(listingMapHeader))
+	{
+		mapSize = status.st_size;
+		map = mmap(NULL, mapSize, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	}
+	close(descriptor);
+
+	// The map must belong to this source and to an object file with the same control sections
+	if (map != MAP_FAILED)
+	{
+		header = (listingMapHeader*)map;
+		loadSourceFile(filename, &source);
+		programCount = loadObjectFile(objFilename, &programs);
+		matched = memcmp(header->magic, LISTING_MAP_MAGIC, sizeof(header->magic)) == 0 &&
+			header->version == LISTING_MAP_VERSION &&
+			header->textOffset + (size_t)header->textSize <= mapSize &&
+			header->entryOffset + (size_t)header->entryCount * sizeof(listingMapEntry) <= mapSize &&
+			header->sectionOffset + (size_t)header->sectionCount * sizeof(listingMapSection) <= mapSize &&
+			header->sourceLineCount == (uint32_t)source.count && header->sourceHash == hashSourceLines(&source) &&
+			programCount == (int)header->sectionCount;
+	}
+
+	FILE* file = openMemoryStream(&text, &size);
+	for (uint32_t x = 0; matched && x < header->sectionCount; x++)
+	{
+		listingMapSection* section = (listingMapSection*)((char*)map + header->sectionOffset) + x;
+		listingMapEntry* entries = (listingMapEntry*)((char*)map + header->entryOffset);
+		char* strings = (char*)map + header->textOffset;
+		objectProgram* program = &programs[x];
+
+		// A section starts on a new line when the previous one did not end with one
+		fflush(file);
+		if (x > 0 && size > 0 && text[size - 1] != NEW_LINE)
+		{
+			fputc(NEW_LINE, file);
+		}
+		if (section->firstEntry + (size_t)section->entryCount > header->entryCount || section->trailerOffset + (size_t)section->trailerSize > header->textSize)
+		{
+			matched = false;
+			break;
+		}
+		for (uint32_t y = section->firstEntry; y < section->firstEntry + section->entryCount; y++)
+		{
+			char statement[INPUT_BUF_SIZE];
+			uint32_t line = entries[y].line;
+			int address = entries[y].location >> 8;
+			int byteCount = entries[y].location & 0xFF;
+			int offset = address - program->start;
+
+			if (line & LISTING_MAP_INLINE)
+			{
+				snprintf(statement, INPUT_BUF_SIZE, "%s", (line & ~LISTING_MAP_INLINE) < header->textSize ? strings + (line & ~LISTING_MAP_INLINE) : "");
+			}
+			else if ((line & LISTING_MAP_LINE_MASK) < (uint32_t)source.count)
+			{
+				memcpy(statement, source.lines[line & LISTING_MAP_LINE_MASK], INPUT_BUF_SIZE);
+				if (line & LISTING_MAP_EXTENDED)
+				{
+					extendStatement(statement);
+				}
+			}
+			else
+			{
+				matched = false;
+				break;
+			}
+
+			// The object code of the statement is read back from the memory image of its section
+			if (byteCount > 0 && (offset < 0 || offset + byteCount > program->length || !program->present[offset]))
+			{
+				matched = false;
+				break;
+			}
+			format(file, address, statement, byteCount > 0 ? &program->bytes[offset] : NULL, byteCount);
+		}
+		fwrite(strings + section->trailerOffset, 1, section->trailerSize, file);
+	}
+	fclose(file);
+
+	if (matched)
+	{
+		writeFileIfChanged(lstFilename, text, size);
+	}
+	else
+	{
+		displayError(STALE_LISTING_MAP, mapFilename);
+	}
+
+	releaseMemory(text);
+	if (map != MAP_FAILED)
+	{
+		munmap(map, mapSize);
+	}
+	freeSourceLines(&source);
+	if (programCount > 0)
+	{
+		freeObjectPrograms(programs, programCount);
+	}
+	releaseMemory(mapFilename);
+	releaseMemory(objFilename);
+	releaseMemory(lstFilename);
+	return matched ? 0 : -1;
+}
+
+// Rebuilds the listing of each source file from its listing map
+// Returns the number of listings that could not be rebuilt
+int rebuildListings(char* filenames[], int count, void (*format)(FILE*, int, char*, unsigned char*, int))
+{
+	int failures = 0;
+
+	for (int x = 0; x < count; x++)
+	{
+		failures += rebuildListing(filenames[x], format) != 0;
+	}
+	return failures;
+}
+
+// Writes the listing map of every control section. Each listed statement refers to its line in
+// the source after macro expansion; statements format selection extended refer to the line they
+// came from, and LDB/BASE pairs inserted by BASE analysis are stored as text
+void writeListingMap(controlSection* sections, int count, sourceLines* source, char* filename)
+{
+	listingMapHeader header = { { 0 }, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+	listingMapSection* sectionEntries = allocateZeroedMemory(count, sizeof(listingMapSection));
+	listingMapEntry* entries;
+	uint32_t entryCount = 0;
+	char* strings = NULL;
+	size_t stringSize = 0;
+	FILE* stringFile = openMemoryStream(&strings, &stringSize);
+	char* text = NULL;
+	size_t size = 0;
+	int original = 0;
+	FILE* file;
+
+	for (int x = 0; x < count; x++)
+	{
+		entryCount += sections[x].mapCount;
+	}
+	entries = allocateMemory(sizeof(listingMapEntry) * (entryCount + 1));
+	entryCount = 0;
+
+	for (int x = 0; x < count; x++)
+	{
+		controlSection* section = &sections[x];
+		uint32_t* lines = allocateMemory(sizeof(uint32_t) * (section->source.count + 1));
+
+		// Sections hold the source statements in order, apart from the changes made by BASE
+		// analysis and format selection, so each statement is matched against the next source line
+		for (int y = 0; y < section->source.count; y++)
+		{
+			char extended[INPUT_BUF_SIZE];
+
+			lines[y] = LISTING_MAP_INLINE;
+			if (original < source->count)
+			{
+				memcpy(extended, source->lines[original], INPUT_BUF_SIZE);
+				extendStatement(extended);
+				if (strncmp(section->source.lines[y], source->lines[original], INPUT_BUF_SIZE) == 0)
+				{
+					lines[y] = original++;
+				}
+				else if (strncmp(section->source.lines[y], extended, INPUT_BUF_SIZE) == 0)
+				{
+					lines[y] = original++ | LISTING_MAP_EXTENDED;
+				}
+			}
+		}
+
+		sectionEntries[x].firstEntry = entryCount;
+		sectionEntries[x].entryCount = section->mapCount;
+		for (int y = 0; y < section->mapCount; y++)
+		{
+			listingMapEntry* entry = &entries[entryCount++];
+
+			*entry = section->mapEntries[y];
+			if (lines[entry->line] == LISTING_MAP_INLINE)
+			{
+				fflush(stringFile);
+				lines[entry->line] = LISTING_MAP_INLINE | (uint32_t)stringSize;
+				fprintf(stringFile, "%.*s%c", INPUT_BUF_SIZE, section->source.lines[entry->line], '\0');
+			}
+			entry->line = lines[entry->line];
+		}
+
+		// The listing text written in the map's place holds only what follows the statements
+		fflush(stringFile);
+		sectionEntries[x].trailerOffset = stringSize;
+		sectionEntries[x].trailerSize = section->lstSize;
+		fwrite(section->lstBuffer, 1, section->lstSize, stringFile);
+		releaseMemory(lines);
+	}
+	fclose(stringFile);
+
+	memcpy(header.magic, LISTING_MAP_MAGIC, sizeof(header.magic));
+	header.version = LISTING_MAP_VERSION;
+	header.sectionCount = count;
+	header.entryCount = entryCount;
+	header.textSize = stringSize;
+	header.sourceLineCount = source->count;
+	header.sourceHash = hashSourceLines(source);
+	header.sectionOffset = sizeof(listingMapHeader);
+	header.entryOffset = header.sectionOffset + count * sizeof(listingMapSection);
+	header.textOffset = header.entryOffset + entryCount * sizeof(listingMapEntry);
+
+	file = openMemoryStream(&text, &size);
+	fwrite(&header, sizeof(listingMapHeader), 1, file);
+	fwrite(sectionEntries, sizeof(listingMapSection), count, file);
+	fwrite(entries, sizeof(listingMapEntry), entryCount, file);
+	fwrite(strings, 1, stringSize, file);
+	fclose(file);
+	writeFileIfChanged(filename, text, size);
+	releaseMemory(text);
+	releaseMemory(strings);
+
+	releaseMemory(sectionEntries);
+	releaseMemory(entries);
+}
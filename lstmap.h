@@ -0,0 +1,49 @@
+#pragma once
+
+#define LISTING_MAP_EXTENDED 0x40000000u // Set in a line reference whose statement format selection extended
+#define LISTING_MAP_INLINE 0x80000000u   // Set in a line reference that names inline statement text
+#define LISTING_MAP_MAGIC "SXLM"
+#define LISTING_MAP_VERSION 1
+
+struct controlSection;
+
+// Binary listing map layout, written instead of the listing and read by --rebuild-listing;
+// every field is a native 32-bit value so the file can be mapped and read in place:
+//   listingMapHeader
+//   listingMapSection[sectionCount]  control sections in source order
+//   listingMapEntry[entryCount]      listed statements in listing order
+//   char[textSize]                   inline statements and the text that follows each section
+typedef struct listingMapHeader
+{
+	char magic[4];            // LISTING_MAP_MAGIC
+	uint32_t version;         // LISTING_MAP_VERSION
+	uint32_t sectionCount;
+	uint32_t entryCount;
+	uint32_t textSize;
+	uint32_t sourceLineCount; // Statements of the source file after macro expansion
+	uint32_t sourceHash;      // FNV-1a hash of those statements
+	uint32_t sectionOffset;   // Byte offsets from the start of the file
+	uint32_t entryOffset;
+	uint32_t textOffset;
+} listingMapHeader;
+
+// Used to store one control section of the listing map
+typedef struct listingMapSection
+{
+	uint32_t firstEntry;
+	uint32_t entryCount;
+	uint32_t trailerOffset;   // Text written after the last statement, such as the cross-reference
+	uint32_t trailerSize;
+} listingMapSection;
+
+// Used to store one listed statement: the source statement, and the address and length of
+// its object code, which is read back from the object file
+typedef struct listingMapEntry
+{
+	uint32_t line;            // Statement index in the source and flags; with LISTING_MAP_INLINE, a text offset
+	uint32_t location;        // Address << 8 | object code bytes
+} listingMapEntry;
+
+void addListingMapEntry(struct controlSection* section, int line, int address, int size);
+int rebuildListings(char* filenames[], int count, void (*format)(FILE*, int, char*, unsigned char*, int));
+void writeListingMap(struct controlSection* sections, int count, sourceLines* source, char* filename);
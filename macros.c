@@ -0,0 +1,437 @@
+#include "headers.h"
+
+#define ARGUMENT_SEPARATOR ','
+#define COMMENT '#'
+#define EMPTY_EXPANSION -1
+#define INITIAL_MACRO_CAPACITY 8
+#define MACRO_DEPTH_LIMIT 16
+#define PARAMETER_CHARACTER '&'
+#define PARAMETER_MARKER '\x01'
+
+int addExpansion(macro* definition, char* arguments, int firstLine, int lineCount);
+unsigned int computeArgumentHash(char* arguments);
+void copyField(char* line, int start, int width, char* field);
+int createExpansion(macroTable* macros, macro* definition, char* arguments, int depth);
+void defineMacro(macroTable* macros, char* name, char* parameters);
+void expandMacro(macroTable* macros, macro* definition, char* label, char* arguments, sourceLines* source, int depth);
+int findExpansion(macro* definition, char* arguments);
+macro* findMacro(macroTable* macros, char* name);
+int splitArguments(char* arguments, char values[][INPUT_BUF_SIZE]);
+void substituteParameters(char* field, char values[][INPUT_BUF_SIZE], int valueCount, char* result);
+void tokenizeParameters(macro* definition, char* field, char* result);
+
+// Records a new memoized expansion and adds it to the hash index
+// Returns the index of the expansion
+int addExpansion(macro* definition, char* arguments, int firstLine, int lineCount)
+{
+	unsigned int mask;
+	int index;
+
+	if (definition->expansionCount == definition->expansionCapacity)
+	{
+		definition->expansionCapacity = definition->expansionCapacity > 0 ? definition->expansionCapacity * 2 : INITIAL_MACRO_CAPACITY;
+		definition->expansions = resizeMemory(definition->expansions, sizeof(macroExpansion) * definition->expansionCapacity);
+	}
+	index = definition->expansionCount++;
+	strcpy(definition->expansions[index].arguments, arguments);
+	definition->expansions[index].firstLine = firstLine;
+	definition->expansions[index].lineCount = lineCount;
+
+	// Keep the hash index at most half full, rebuilding it when it grows
+	if (definition->expansionCount * 2 > definition->expansionIndexSize)
+	{
+		definition->expansionIndexSize = definition->expansionIndexSize > 0 ? definition->expansionIndexSize * 2 : INITIAL_MACRO_CAPACITY * 2;
+		definition->expansionIndex = resizeMemory(definition->expansionIndex, sizeof(int) * definition->expansionIndexSize);
+		memset(definition->expansionIndex, EMPTY_EXPANSION, sizeof(int) * definition->expansionIndexSize);
+		mask = definition->expansionIndexSize - 1;
+		for (int x = 0; x < definition->expansionCount; x++)
+		{
+			unsigned int slot = computeArgumentHash(definition->expansions[x].arguments) & mask;
+			while (definition->expansionIndex[slot] != EMPTY_EXPANSION)
+			{
+				slot = (slot + 1) & mask;
+			}
+			definition->expansionIndex[slot] = x;
+		}
+	}
+	else
+	{
+		mask = definition->expansionIndexSize - 1;
+		unsigned int slot = computeArgumentHash(arguments) & mask;
+		while (definition->expansionIndex[slot] != EMPTY_EXPANSION)
+		{
+			slot = (slot + 1) & mask;
+		}
+		definition->expansionIndex[slot] = index;
+	}
+	return index;
+}
+
+// Compute an FNV-1a hash value for the provided argument list
+unsigned int computeArgumentHash(char* arguments)
+{
+	unsigned int hash = 2166136261u;
+
+	for (int x = 0; arguments[x] != '\0'; x++)
+	{
+		hash ^= (unsigned char)arguments[x];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// Copies the characters of a statement column up to the first white space
+void copyField(char* line, int start, int width, char* field)
+{
+	int length = strlen(line);
+	int x = 0;
+
+	while (start + x < length && x < width && !isspace(line[start + x]))
+	{
+		field[x] = line[start + x];
+		x++;
+	}
+	field[x] = '\0';
+}
+
+// Substitutes the provided arguments into the macro body and stores the resulting statements
+// Returns the index of the new memoized expansion
+int createExpansion(macroTable* macros, macro* definition, char* arguments, int depth)
+{
+	char values[MAX_MACRO_PARAMETERS][INPUT_BUF_SIZE];
+	char label[INPUT_BUF_SIZE];
+	char operation[INPUT_BUF_SIZE];
+	char operand[INPUT_BUF_SIZE];
+	char line[INPUT_BUF_SIZE];
+	int firstLine = definition->expandedLines.count;
+	int valueCount = splitArguments(arguments, values);
+	macro* nested;
+
+	if (valueCount > definition->parameterCount)
+	{
+		displayError(ILLEGAL_MACRO_INVOCATION, definition->name);
+		exit(-1);
+	}
+
+	for (int x = 0; x < definition->bodyCount; x++)
+	{
+		substituteParameters(definition->body[x].label, values, valueCount, label);
+		substituteParameters(definition->body[x].operation, values, valueCount, operation);
+		substituteParameters(definition->body[x].operand, values, valueCount, operand);
+
+		if ((nested = findMacro(macros, operation)) != NULL)
+		{
+			expandMacro(macros, nested, label, operand, &definition->expandedLines, depth + 1);
+		}
+		else
+		{
+			// A substituted statement must still fit the columns and length of a source line
+			if (strlen(label) > SEGMENT_SIZE - 1 || strlen(operation) > SEGMENT_SIZE - 1 ||
+				snprintf(line, INPUT_BUF_SIZE, "%-*s%-*s%s\n", SEGMENT_SIZE - 1, label, SEGMENT_SIZE - 1, operation, operand) >= INPUT_BUF_SIZE)
+			{
+				displayError(ILLEGAL_MACRO_INVOCATION, definition->name);
+				exit(-1);
+			}
+			appendSourceLine(&definition->expandedLines, line);
+		}
+	}
+	return addExpansion(definition, arguments, firstLine, definition->expandedLines.count - firstLine);
+}
+
+// Starts a new macro definition using the provided name and parameter list
+void defineMacro(macroTable* macros, char* name, char* parameters)
+{
+	char values[MAX_MACRO_PARAMETERS][INPUT_BUF_SIZE];
+	int valueCount = splitArguments(parameters, values);
+	macro* definition;
+
+	if (strlen(name) == 0 || strlen(name) > SEGMENT_SIZE - 1 || isDirective(name) || isOpcode(name) || findMacro(macros, name) != NULL)
+	{
+		displayError(ILLEGAL_MACRO_DEFINITION, name);
+		exit(-1);
+	}
+
+	if (macros->count == macros->capacity)
+	{
+		macros->capacity = macros->capacity > 0 ? macros->capacity * 2 : INITIAL_MACRO_CAPACITY;
+		macros->macros = resizeMemory(macros->macros, sizeof(macro) * macros->capacity);
+	}
+	definition = &macros->macros[macros->count++];
+	memset(definition, 0, sizeof(macro));
+	strcpy(definition->name, name);
+
+	// Parameters are a comma separated list of &NAME entries
+	for (int x = 0; x < valueCount; x++)
+	{
+		if (x == MAX_MACRO_PARAMETERS || values[x][0] != PARAMETER_CHARACTER || strlen(values[x]) < 2 || strlen(values[x]) > SEGMENT_SIZE)
+		{
+			displayError(ILLEGAL_MACRO_DEFINITION, name);
+			exit(-1);
+		}
+		strcpy(definition->parameters[definition->parameterCount++], values[x] + 1);
+	}
+	macros->defining = true;
+}
+
+// Appends the statements of a macro invocation to the source lines, reusing a memoized
+// expansion when the macro was already expanded with the same argument list
+void expandMacro(macroTable* macros, macro* definition, char* label, char* arguments, sourceLines* source, int depth)
+{
+	int firstLine = source->count;
+	int index;
+
+	if (depth > MACRO_DEPTH_LIMIT)
+	{
+		displayError(ILLEGAL_MACRO_INVOCATION, definition->name);
+		exit(-1);
+	}
+
+	if ((index = findExpansion(definition, arguments)) == EMPTY_EXPANSION)
+	{
+		index = createExpansion(macros, definition, arguments, depth);
+	}
+	appendSourceLines(source, &definition->expandedLines, definition->expansions[index].firstLine, definition->expansions[index].lineCount);
+
+	// The invocation label is given to the first expanded statement
+	if (strlen(label) > 0)
+	{
+		if (source->count == firstLine || !isspace(source->lines[firstLine][0]))
+		{
+			displayError(ILLEGAL_MACRO_INVOCATION, definition->name);
+			exit(-1);
+		}
+		memcpy(source->lines[firstLine], label, strlen(label) < SEGMENT_SIZE - 1 ? strlen(label) : SEGMENT_SIZE - 1);
+	}
+}
+
+// Returns the index of the memoized expansion for the provided argument list; otherwise, -1
+int findExpansion(macro* definition, char* arguments)
+{
+	unsigned int mask = definition->expansionIndexSize - 1;
+	unsigned int slot;
+
+	if (definition->expansionIndexSize == 0)
+	{
+		return EMPTY_EXPANSION;
+	}
+	slot = computeArgumentHash(arguments) & mask;
+	while (definition->expansionIndex[slot] != EMPTY_EXPANSION)
+	{
+		if (strcmp(definition->expansions[definition->expansionIndex[slot]].arguments, arguments) == 0)
+		{
+			return definition->expansionIndex[slot];
+		}
+		slot = (slot + 1) & mask;
+	}
+	return EMPTY_EXPANSION;
+}
+
+// Returns the macro with the provided name; otherwise, NULL
+macro* findMacro(macroTable* macros, char* name)
+{
+	for (int x = 0; x < macros->count; x++)
+	{
+		if (strcmp(macros->macros[x].name, name) == 0)
+		{
+			return &macros->macros[x];
+		}
+	}
+	return NULL;
+}
+
+// Tests that every macro definition was closed by a MEND statement
+void finishMacros(macroTable* macros)
+{
+	if (macros->defining)
+	{
+		displayError(ILLEGAL_MACRO_DEFINITION, macros->macros[macros->count - 1].name);
+		exit(-1);
+	}
+}
+
+// Releases the macro definitions and their memoized expansions
+void freeMacroTable(macroTable* macros)
+{
+	for (int x = 0; x < macros->count; x++)
+	{
+		releaseMemory(macros->macros[x].body);
+		releaseMemory(macros->macros[x].expansions);
+		releaseMemory(macros->macros[x].expansionIndex);
+		freeSourceLines(&macros->macros[x].expandedLines);
+	}
+	releaseMemory(macros->macros);
+	memset(macros, 0, sizeof(macroTable));
+}
+
+// Processes one statement of the source file, already split into its columns: records macro
+// definitions, expands macro invocations and passes every other statement through unchanged
+void processMacroStatement(macroTable* macros, sourceLines* source, char* line, sourceStatement* statement)
+{
+	char* label = statement->label;
+	char* operation = statement->operation;
+	char* operand = statement->operand;
+	macro* definition;
+
+	if (line[0] == COMMENT || line[0] < ' ')
+	{
+		// Comments inside a definition are dropped; blank lines are reported by Pass 1
+		if (!macros->defining || line[0] != COMMENT)
+		{
+			appendSourceLine(source, line);
+		}
+		return;
+	}
+
+	if (macros->defining)
+	{
+		definition = &macros->macros[macros->count - 1];
+		if (strcmp(operation, "MEND") == 0)
+		{
+			macros->defining = false;
+			return;
+		}
+		if (strcmp(operation, "MACRO") == 0)
+		{
+			displayError(ILLEGAL_MACRO_DEFINITION, label);
+			exit(-1);
+		}
+		if (definition->bodyCount == definition->bodyCapacity)
+		{
+			definition->bodyCapacity = definition->bodyCapacity > 0 ? definition->bodyCapacity * 2 : INITIAL_MACRO_CAPACITY;
+			definition->body = resizeMemory(definition->body, sizeof(macroStatement) * definition->bodyCapacity);
+		}
+		tokenizeParameters(definition, label, definition->body[definition->bodyCount].label);
+		tokenizeParameters(definition, operation, definition->body[definition->bodyCount].operation);
+		tokenizeParameters(definition, operand, definition->body[definition->bodyCount].operand);
+		definition->bodyCount++;
+	}
+	else if (strcmp(operation, "MACRO") == 0)
+	{
+		defineMacro(macros, label, operand);
+	}
+	else if (strcmp(operation, "MEND") == 0)
+	{
+		displayError(ILLEGAL_MACRO_DEFINITION, operation);
+		exit(-1);
+	}
+	else if ((definition = findMacro(macros, operation)) != NULL)
+	{
+		expandMacro(macros, definition, label, operand, source, 0);
+	}
+	else
+	{
+		appendSourceLine(source, line);
+	}
+}
+
+// Separates the comma separated argument list of a macro invocation
+// Returns the number of arguments found
+int splitArguments(char* arguments, char values[][INPUT_BUF_SIZE])
+{
+	int count = 0;
+	int length = 0;
+
+	if (strlen(arguments) == 0)
+	{
+		return 0;
+	}
+	for (int x = 0; ; x++)
+	{
+		if (arguments[x] == ARGUMENT_SEPARATOR || arguments[x] == '\0')
+		{
+			if (count == MAX_MACRO_PARAMETERS)
+			{
+				return MAX_MACRO_PARAMETERS + 1;
+			}
+			values[count][length] = '\0';
+			count++;
+			length = 0;
+			if (arguments[x] == '\0')
+			{
+				return count;
+			}
+		}
+		else if (count < MAX_MACRO_PARAMETERS)
+		{
+			values[count][length++] = arguments[x];
+		}
+	}
+}
+
+// Separates a statement into its label, operation and operand columns
+// Unlike prepareSegments(), the operand keeps its full length so argument lists are not truncated
+void splitStatement(char* line, char* label, char* operation, char* operand)
+{
+	copyField(line, 0, SEGMENT_SIZE - 1, label);
+	copyField(line, SEGMENT_SIZE - 1, SEGMENT_SIZE - 1, operation);
+	copyField(line, (SEGMENT_SIZE - 1) * 2, INPUT_BUF_SIZE - 1, operand);
+}
+
+// Replaces each parameter marker in a body field with the matching argument value
+void substituteParameters(char* field, char values[][INPUT_BUF_SIZE], int valueCount, char* result)
+{
+	int length = 0;
+
+	for (int x = 0; field[x] != '\0'; x++)
+	{
+		if (field[x] == PARAMETER_MARKER)
+		{
+			int parameter = field[++x] - 1;
+			if (parameter < valueCount)
+			{
+				for (int y = 0; values[parameter][y] != '\0' && length < INPUT_BUF_SIZE - 1; y++)
+				{
+					result[length++] = values[parameter][y];
+				}
+			}
+		}
+		else if (length < INPUT_BUF_SIZE - 1)
+		{
+			result[length++] = field[x];
+		}
+	}
+	result[length] = '\0';
+}
+
+// Replaces each &NAME parameter reference in a body field with a two-byte marker holding
+// the parameter position, so expansion does not need to search for parameter names
+void tokenizeParameters(macro* definition, char* field, char* result)
+{
+	char name[INPUT_BUF_SIZE];
+	int length = 0;
+
+	for (int x = 0; field[x] != '\0'; )
+	{
+		int parameter = -1;
+		int nameLength = 0;
+
+		if (field[x] == PARAMETER_CHARACTER)
+		{
+			while (isalnum(field[x + 1 + nameLength]))
+			{
+				name[nameLength] = field[x + 1 + nameLength];
+				nameLength++;
+			}
+			name[nameLength] = '\0';
+			for (int y = 0; y < definition->parameterCount && parameter < 0; y++)
+			{
+				if (strcmp(definition->parameters[y], name) == 0)
+				{
+					parameter = y;
+				}
+			}
+		}
+
+		if (parameter >= 0)
+		{
+			result[length++] = PARAMETER_MARKER;
+			result[length++] = (char)(parameter + 1);
+			x += nameLength + 1;
+		}
+		else
+		{
+			result[length++] = field[x++];
+		}
+	}
+	result[length] = '\0';
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#define MAX_MACRO_PARAMETERS 16
+
+// Used to store a macro body statement with its parameter references pre-tokenized
+typedef struct macroStatement
+{
+	char label[INPUT_BUF_SIZE];
+	char operation[INPUT_BUF_SIZE];
+	char operand[INPUT_BUF_SIZE];
+} macroStatement;
+
+// Used to memoize the expanded statements of a macro for one argument list
+typedef struct macroExpansion
+{
+	char arguments[INPUT_BUF_SIZE];
+	int firstLine;
+	int lineCount;
+} macroExpansion;
+
+// Used to store a macro definition along with its memoized expansions
+typedef struct macro
+{
+	char name[SEGMENT_SIZE];
+	char parameters[MAX_MACRO_PARAMETERS][SEGMENT_SIZE];
+	int parameterCount;
+	macroStatement* body;
+	int bodyCount;
+	int bodyCapacity;
+	macroExpansion* expansions;
+	int expansionCount;
+	int expansionCapacity;
+	int* expansionIndex;       // Open-addressing hash index into expansions
+	int expansionIndexSize;
+	sourceLines expandedLines; // Statements of every memoized expansion
+} macro;
+
+// Used to manage the macros defined by a source file
+typedef struct macroTable
+{
+	macro* macros;
+	int count;
+	int capacity;
+	bool defining; // True while reading the body of macros[count - 1]
+} macroTable;
+
+void finishMacros(macroTable* macros);
+void freeMacroTable(macroTable* macros);
+void processMacroStatement(macroTable* macros, sourceLines* source, char* line, sourceStatement* statement);
+void splitStatement(char* line, char* label, char* operation, char* operand);
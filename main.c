@@ -1,11 +1,10 @@
 #include "headers.h"
+#include <getopt.h>
 
 // Pass 1 constants
 #define COMMENT 35
-#define INPUT_BUF_SIZE 60
 #define NEW_LINE 10
 #define SPACE 32
-#define SYMBOL_TABLE_SIZE 100
 
 // Pass 2 constants
 #define BLANK_INSTRUCTION 0x000000
@@ -18,15 +17,14 @@
 #define FORMAT_1 1
 #define FORMAT_2 2
 #define FORMAT_3 3
-#define FORMAT_3_MULTIPLIER 0x1000
 #define FORMAT_4 4
-#define FORMAT_4_MULTIPLIER 0x100000
 #define IMMEDIATE_CHARACTER '#'
 #define INDEX_STRING ",X"
 #define INDIRECT_CHARACTER '@'
+#define MAX_DEFINITIONS_PER_RECORD 6
 #define MAX_RECORD_BYTE_COUNT 30
-#define OPCODE_MULTIPLIER 0x100
-#define OUTPUT_BUF_SIZE 70
+#define MAX_REFERENCES_PER_RECORD 12
+#define MODIFICATION_LENGTH 5
 #define REGISTER_A 0X0
 #define REGISTER_B 0X3
 #define REGISTER_L 0X2
@@ -35,152 +33,524 @@
 #define REGISTER_T 0X5
 #define REGISTER_X 0X1
 #define RSUB_INSTRUCTION 0x4C0000
-#define BASE_MAX_RANGE 4096
-#define PC_MAX_RANGE 2048
-#define PC_MIN_RANGE -2048
 
 // Pass 1 functions
-void performPass1(symbol* symbolTable[], char* filename, address* addresses);
-segment* prepareSegments(char* line);
+int assembleFile(char* filename, options* settings);
+int runAssembly(char* filename, options* settings);
+void assembleSection(controlSection* section, options* settings);
+void performPass1(controlSection* section, options* settings);
 void trim(char string[]);
 
 // Pass 2 functions
-int computeFlagsAndAddress(struct symbol* symbolArray[], address* addresses, segment* segments, int format);
-char* createFilename(char* filename, const char* extension);
-void flushTextRecord(FILE* file, objectFileData* data, address* addresses);
+void addModificationRecord(objectFileData* data, int address, int length, char* symbolName);
+void addDataFragment(objectFileData* data, int address, unsigned char* bytes, int numBytes);
+void addTextFragment(objectFileData* data, int address, int value, int numBytes);
+void appendToTextRecord(FILE* file, objectFileData* data, int address, unsigned char* bytes, int numBytes);
+int computeFlagsAndAddress(controlSection* section, parsedOperand* operand, segment* segments);
+void flushTextRecord(FILE* file, objectFileData* data);
+int getAddressingFlags(char* operand, int format);
 int getRegisters(char* operand);
 int getRegisterValue(char registerName);
-bool isNumeric(char* string);
-void performPass2(struct symbol* symbolTable[], char* filename, address* addresses);
-void writeToLstFile(FILE* file, int address, segment* segments, int opcode);
+void listStatement(controlSection* section, options* settings, listingWriter* listing, int line, int address, segment* segments, int opcode, unsigned char* bytes, int size);
+int compareTextFragments(const void* first, const void* second);
+void performPass2(controlSection* section, options* settings);
+void releaseObjectData(void* data);
+void writeExternalSymbols(FILE* file, objectFileData* data, controlSection* section, segment* segments, char recordType);
+void writeToLstFile(FILE* file, int address, segment* segments, int opcode, unsigned char* bytes, int size);
+void writeMappedListingLine(FILE* file, int address, char* statement, unsigned char* bytes, int size);
+void writeTextFragments(FILE* file, objectFileData* data);
 void writeToObjFile(FILE* file, objectFileData data);
 
 int main(int argc, char* argv[])
 {
-	address addresses = { 0x00, 0x00, 0x00 };
+	options settings = { .cacheDirectory = getenv(CACHE_DIRECTORY_VARIABLE), .cacheLimit = CACHE_DEFAULT_LIMIT, .maxSteps = DEFAULT_MAX_STEPS };
+	static struct option longOptions[] = {
+		{ "base-analysis", no_argument, NULL, 'b' },
+		{ "insert-base", no_argument, NULL, 'B' },
+		{ "baseline", required_argument, NULL, 'L' },
+		{ "batch", no_argument, NULL, 'R' },
+		{ "cache", required_argument, NULL, 'C' },
+		{ "cache-size", required_argument, NULL, 'S' },
+		{ "cache-stats", no_argument, NULL, 's' },
+		{ "cross-reference", no_argument, NULL, 'r' },
+		{ "golden", required_argument, NULL, 'g' },
+		{ "jobs", required_argument, NULL, 'J' },
+		{ "listing-map", no_argument, NULL, 'l' },
+		{ "max-steps", required_argument, NULL, 'T' },
+		{ "memory-limit", required_argument, NULL, 'M' },
+		{ "memory-stats", no_argument, NULL, 'm' },
+		{ "disassemble", no_argument, NULL, 'd' },
+		{ "no-listing", no_argument, NULL, 'n' },
+		{ "optimize", no_argument, NULL, 'O' },
+		{ "profile", no_argument, NULL, 'p' },
+		{ "quiet", no_argument, NULL, 'q' },
+		{ "rebuild-listing", no_argument, NULL, 'u' },
+		{ "regress", no_argument, NULL, 'e' },
+		{ "timings", required_argument, NULL, 't' },
+		{ "verify", no_argument, NULL, 'V' },
+		{ "watch", no_argument, NULL, 'w' },
+		{ "extended-records", no_argument, NULL, 'x' },
+		{ NULL, 0, NULL, 0 }
+	};
+	int option;
+
+	while ((option = getopt_long(argc, argv, "bBC:dnOpqrVwx", longOptions, NULL)) != -1)
+	{
+		switch (option)
+		{
+			case 'b':
+				settings.analyzeBases = true;
+				break;
+			case 'B':
+				settings.analyzeBases = settings.insertBases = true;
+				break;
+			case 'C':
+				settings.cacheDirectory = optarg;
+				break;
+			case 'd':
+				settings.disassemble = true;
+				break;
+			case 'e':
+				settings.regress = true;
+				break;
+			case 'g':
+				settings.goldenDirectory = optarg;
+				break;
+			case 'J':
+				settings.jobs = (int)strtol(optarg, NULL, 10);
+				break;
+			case 'l':
+				settings.listingMap = true;
+				break;
+			case 's':
+				settings.cacheStatistics = true;
+				break;
+			case 'S':
+				settings.cacheLimit = strtol(optarg, NULL, 10) * 1024 * 1024;
+				break;
+			case 't':
+				settings.timingFile = optarg;
+				break;
+			case 'T':
+				settings.maxSteps = strtol(optarg, NULL, 10);
+				break;
+			case 'L':
+				settings.baselineFile = optarg;
+				break;
+			case 'm':
+				settings.memoryStatistics = true;
+				break;
+			case 'M':
+				settings.memoryLimit = (size_t)strtol(optarg, NULL, 10) * 1024 * 1024;
+				setMemoryLimit(settings.memoryLimit);
+				break;
+			case 'n':
+				settings.skipListing = true;
+				break;
+			case 'O':
+				settings.optimizeFormats = true;
+				break;
+			case 'p':
+				settings.profile = true;
+				break;
+			case 'q':
+				settings.quiet = true;
+				break;
+			case 'r':
+				settings.crossReference = true;
+				break;
+			case 'R':
+				settings.batch = true;
+				break;
+			case 'u':
+				settings.rebuildListing = true;
+				break;
+			case 'V':
+				settings.disassemble = settings.verify = true;
+				break;
+			case 'w':
+				settings.watch = true;
+				break;
+			case 'x':
+				settings.extendedRecords = true;
+				break;
+			default:
+				displayError(MISSING_COMMAND_LINE_ARGUMENTS, argv[0]);
+				exit(-1);
+		}
+	}
+
+	// Report the output cache, which needs no input file
+	if (settings.cacheStatistics && settings.cacheDirectory != NULL)
+	{
+		displayCacheStatistics(settings.cacheDirectory, settings.cacheLimit);
+		if (optind >= argc)
+		{
+			return 0;
+		}
+	}
 
 	// Check whether at least one (1) input file was provided
-	if(argc < 2)
+	if(optind >= argc)
 	{
 		displayError(MISSING_COMMAND_LINE_ARGUMENTS, argv[0]);
 		exit(-1);
 	}
-	symbol* symbols[SYMBOL_TABLE_SIZE] = { NULL };
-	
-	// Pass 1 - processes SIC/XE code, loads symbols into symbol table, and computes addressing
-	performPass1(symbols, argv[1], &addresses);
 
-	// Display symbol table data
-	displaySymbolTable(symbols);
+	// Disassembly - lists or verifies each object file provided
+	if (settings.disassemble)
+	{
+		return disassembleFiles(&argv[optind], argc - optind, settings.verify, assembleSection) > 0;
+	}
+
+	// Profiling - runs each object file in the simulator and reports its hot spots
+	if (settings.profile)
+	{
+		return profileFiles(&argv[optind], argc - optind, settings.maxSteps) > 0;
+	}
 
-	// Display the assembly summary data
-	printf("\nStarting Address: 0x%X\nEnding Address: 0x%X\nProgram Size (bytes): %d\n", addresses.start, addresses.current, addresses.current - addresses.start);
-	
-	// Pass 2 - creates object code file and listing file
-	performPass2(symbols, argv[1], &addresses);
+	// Batch simulation - runs every object file to completion on a pool of threads
+	if (settings.batch)
+	{
+		return simulateBatch(&argv[optind], argc - optind, settings.maxSteps, settings.jobs) > 0;
+	}
+
+	// Listing rebuild - formats the listing each source file deferred to its listing map
+	if (settings.rebuildListing)
+	{
+		return rebuildListings(&argv[optind], argc - optind, writeMappedListingLine) > 0;
+	}
+
+	// Regression - assembles every source file in memory and compares it with its golden outputs
+	if (settings.regress)
+	{
+		return runRegression(&argv[optind], argc - optind, &settings, assembleSection) > 0;
+	}
 
+	// Watch mode - reassembles the source file each time it is saved
+	if (settings.watch)
+	{
+		return watchSourceFile(argv[optind], &settings, runAssembly);
+	}
+	return runAssembly(argv[optind], &settings);
 }
 
-// Determines the Format 3/4 flags and computes address displacement for Format 3 instruction
-int computeFlagsAndAddress(symbol* symbolArray[], address* addresses, segment* segments, int format)
+// Assembles one source file and writes its listing, object code and symbol files
+// Returns zero; errors in the source end the process
+int assembleFile(char* filename, options* settings)
 {
-	char buffer[OUTPUT_BUF_SIZE];
-    strcpy(buffer, segments->operand);
+	address addresses = { 0x00, 0x00, 0x00 };
+	cacheKey key = { 0 };
+	char* lstFilename = settings->skipListing || settings->listingMap ? NULL : createFilename(filename, ".lst");
+	char* objFilename = createFilename(filename, ".obj");
+	char* symFilename = createFilename(filename, ".sym");
+	sourceLines source = { NULL, 0, 0 };
+	controlSection* sections = NULL;
+	int sectionCount = 0;
+	assemblyCleanup assembly = { &source, &sections, &sectionCount };
+	errorCleanup cleanups[4];
+	char* summaryText = NULL;
+	size_t summarySize = 0;
+	FILE* summary;
 
-    int bitFlags = 0;
+	// An error recovered by watch mode releases what the assembly holds
+	pushErrorCleanup(&cleanups[0], releaseMemory, lstFilename);
+	pushErrorCleanup(&cleanups[1], releaseMemory, objFilename);
+	pushErrorCleanup(&cleanups[2], releaseMemory, symFilename);
+	pushErrorCleanup(&cleanups[3], releaseAssemblyCleanup, &assembly);
 
-    if (strchr(buffer, IMMEDIATE_CHARACTER) != NULL) {	// Flag I Check
-        bitFlags += FLAG_I;
-        memmove(buffer, buffer + 1, strlen(buffer) + 1);
-    }
-	else if	(strchr(buffer, INDIRECT_CHARACTER) != NULL) {	// Flag N Check
-        bitFlags += FLAG_N;
-        memmove(buffer, buffer + 1, strlen(buffer) + 1);
-    } else {
-        bitFlags += FLAG_I + FLAG_N;
-    }
+	// Macro processing - reads the source file and expands MACRO definitions ahead of Pass 1
+	loadSourceFile(filename, &source);
 
-    if (strstr(buffer, INDEX_STRING) != NULL) { // Flag X Check
-        bitFlags += FLAG_X;
-        char* comma = strstr(buffer, INDEX_STRING);
-		memmove(comma, comma + 2, strlen(comma + 2) + 1);
-    }
+	// Output cache - a program assembled before with the same options skips both passes. The
+	// cache keeps no listing map, so deferred listings are always assembled
+	if (settings->cacheDirectory != NULL && !settings->listingMap)
+	{
+		key = computeCacheKey(&source, settings);
+		if (restoreCachedOutputs(settings->cacheDirectory, &key, lstFilename, objFilename, symFilename, settings->quiet ? NULL : stdout))
+		{
+			for (int x = 3; x >= 0; x--)
+			{
+				popErrorCleanup(&cleanups[x]);
+			}
+			freeSourceLines(&source);
+			releaseMemory(lstFilename);
+			releaseMemory(objFilename);
+			releaseMemory(symFilename);
+			return 0;
+		}
+	}
+
+	// Control sections - each CSECT is assembled with its own symbol table and location counter
+	sectionCount = splitControlSections(&source, &sections);
+	runControlSections(sections, sectionCount, settings, assembleSection);
+
+	// The summary is built in memory so the output cache can replay it
+	summary = openMemoryStream(&summaryText, &summarySize);
+	for (int x = 0; x < sectionCount; x++)
+	{
+		if (sectionCount > 1)
+		{
+			fprintf(summary, "\nControl Section: %s\n", sections[x].name);
+		}
+		fwrite(sections[x].reportBuffer, 1, sections[x].reportSize, summary);
+		if (settings->optimizeFormats)
+		{
+			fprintf(summary, "\nFormat 4 Instructions Selected: %d of %d\n", sections[x].extendedCount, sections[x].references.count);
+		}
 
-    if (format == FORMAT_4) { // Flag E Check
-        bitFlags += FLAG_E;
+		// Display symbol table data
+		displaySymbolTable(summary, sections[x].symbols);
+
+		// Display the assembly summary data
+		addresses = sections[x].addresses;
+		fprintf(summary, "\nStarting Address: 0x%X\nEnding Address: 0x%X\nProgram Size (bytes): %d\n", addresses.start, addresses.end, addresses.end - addresses.start);
+	}
+	fclose(summary);
+	if (!settings->quiet)
+	{
+		fwrite(summaryText, 1, summarySize, stdout);
 	}
 
-    if (strcmp(segments->operation, "RSUB") == 0){ //RSUB Check
-        bitFlags *= FORMAT_3_MULTIPLIER;
-		return bitFlags;
+	// Write the object code file and listing file in source order
+	writeControlSections(sections, sectionCount, lstFilename, objFilename);
+
+	// Write the binary symbol file for debuggers and loaders
+	writeSymbolFile(sections, sectionCount, symFilename);
+
+	// Write the listing map that --rebuild-listing turns into the listing
+	if (settings->listingMap)
+	{
+		char* mapFilename = createFilename(filename, ".lmap");
+		writeListingMap(sections, sectionCount, &source, mapFilename);
+		releaseMemory(mapFilename);
 	}
 
-    
+	// Keep the outputs for the next run of the same program
+	if (settings->cacheDirectory != NULL && !settings->listingMap)
+	{
+		storeCachedOutputs(settings->cacheDirectory, &key, settings->cacheLimit, lstFilename, objFilename, symFilename, summaryText, summarySize);
+	}
 
-    if (isNumeric(buffer)) { //Numeric
-		long int displacement = strtol(buffer, NULL, 10);
-        if (format == FORMAT_3)
-            bitFlags *= FORMAT_3_MULTIPLIER;
-        else if (format == FORMAT_4)
-            bitFlags *= FORMAT_4_MULTIPLIER;
+	releaseMemory(summaryText);
 
-        bitFlags += displacement;
-        return bitFlags;
-    }
-	else if (format == FORMAT_4){ // Non numeric format 4
-		int symbolAddress = getSymbolAddress(symbolArray, buffer);
-		bitFlags *= FORMAT_4_MULTIPLIER;
-		bitFlags += symbolAddress;
-		return bitFlags;
+	for (int x = 3; x >= 0; x--)
+	{
+		popErrorCleanup(&cleanups[x]);
+	}
+	freeControlSections(sections, sectionCount);
+	freeSourceLines(&source);
+	releaseMemory(lstFilename);
+	releaseMemory(objFilename);
+	releaseMemory(symFilename);
+	return 0;
+}
+
+// Assembles one source file and reports the memory the assembly used. Outside watch mode the
+// include cache is emptied first, so everything the assembly allocated is released and the
+// residual memory reported is zero unless an allocation leaked; watch mode keeps the included
+// files for the next assembly
+// Returns the result of assembleFile()
+int runAssembly(char* filename, options* settings)
+{
+	memoryUsage start = getMemoryUsage();
+	int result;
+
+	resetMemoryPeak();
+	result = assembleFile(filename, settings);
+	if (!settings->watch)
+	{
+		trimIncludeCache(0);
+	}
+	if (settings->memoryStatistics)
+	{
+		displayMemoryUsage(stdout, &start);
+	}
+	return result;
+}
+
+// Assembles one control section: Pass 1, the optional BASE analysis and format selection, and Pass 2
+void assembleSection(controlSection* section, options* settings)
+{
+	// Pass 1 - processes SIC/XE code, loads symbols into symbol table, and computes addressing
+	performPass1(section, settings);
 
+	// BASE analysis - suggests BASE regions for references outside the PC-relative range
+	if (settings->analyzeBases && analyzeBases(section, settings) > 0)
+	{
+		// LDB/BASE pairs were inserted, so addresses are computed again
+		freeSymbolTable(section->symbols);
+		freeReferenceTable(&section->references);
+		releaseMemory(section->externalReferences);
+		section->externalReferences = NULL;
+		section->externalReferenceCount = 0;
+		section->addresses = (address){ 0x00, 0x00, 0x00, 0x00, 0x00 };
+		performPass1(section, settings);
 	}
-	else{ // Non numeric format 3 
-		int symbolAddress = getSymbolAddress(symbolArray, buffer);
-		int pcRelative = (symbolAddress - (addresses->current + addresses->increment));
-		int baseRelative = symbolAddress - addresses->base;
-		if (pcRelative >= PC_MIN_RANGE && pcRelative <= PC_MAX_RANGE){
-			bitFlags |= FLAG_P;
 
+	// Format selection - extends only the Format 3 instructions whose operands are out of range
+	if (settings->optimizeFormats)
+	{
+		section->extendedCount = relaxFormats(section);
+	}
+	section->addresses.end = section->addresses.current;
+
+	// Pass 2 - creates object code and listing text
+	performPass2(section, settings);
+}
+
+// Adds an M record entry for a field the loader must modify
+void addModificationRecord(objectFileData* data, int address, int length, char* symbolName)
+{
+	if (data->modificationCount == data->modificationCapacity)
+	{
+		data->modificationCapacity = data->modificationCapacity > 0 ? data->modificationCapacity * 2 : 16;
+		data->modificationEntries = resizeMemory(data->modificationEntries, sizeof(modificationRecord) * data->modificationCapacity);
+	}
+	data->modificationEntries[data->modificationCount].address = address;
+	data->modificationEntries[data->modificationCount].length = length;
+	strcpy(data->modificationEntries[data->modificationCount].symbol, symbolName);
+	data->modificationCount++;
+}
+
+// Holds the bytes of an instruction or constant until the T records are written; the bytes
+// are copied to the byte pool of the fragments, so constants of any length are kept whole
+void addDataFragment(objectFileData* data, int address, unsigned char* bytes, int numBytes)
+{
+	if (data->fragmentCount == data->fragmentCapacity)
+	{
+		data->fragmentCapacity = data->fragmentCapacity > 0 ? data->fragmentCapacity * 2 : 64;
+		data->fragments = resizeMemory(data->fragments, sizeof(textFragment) * data->fragmentCapacity);
+	}
+	while (data->fragmentByteCount + numBytes > data->fragmentByteCapacity)
+	{
+		data->fragmentByteCapacity = data->fragmentByteCapacity > 0 ? data->fragmentByteCapacity * 2 : 256;
+		data->fragmentBytes = resizeMemory(data->fragmentBytes, data->fragmentByteCapacity);
+	}
+	memcpy(&data->fragmentBytes[data->fragmentByteCount], bytes, numBytes);
+	data->fragments[data->fragmentCount].address = address;
+	data->fragments[data->fragmentCount].offset = data->fragmentByteCount;
+	data->fragments[data->fragmentCount].numBytes = numBytes;
+	data->fragments[data->fragmentCount].order = data->fragmentCount;
+	data->fragmentByteCount += numBytes;
+	data->fragmentCount++;
+}
+
+// Holds the object code of an instruction until the T records are written
+void addTextFragment(objectFileData* data, int address, int value, int numBytes)
+{
+	unsigned char bytes[sizeof(int)];
+
+	for (int x = 0; x < numBytes; x++)
+	{
+		bytes[x] = (value >> (8 * (numBytes - 1 - x))) & 0xFF;
+	}
+	addDataFragment(data, address, bytes, numBytes);
+}
+
+// Adds the bytes of an instruction or constant to the open text record, filling each record
+// to its limit and continuing the remaining bytes in the next record
+void appendToTextRecord(FILE* file, objectFileData* data, int address, unsigned char* bytes, int numBytes)
+{
+	// A gap in the addresses (RESB/RESW) closes the open record
+	if (data->recordByteCount > 0 && address != data->recordAddress + data->recordByteCount)
+	{
+		flushTextRecord(file, data);
+	}
+
+	for (int x = 0; x < numBytes; x++)
+	{
+		if (data->recordByteCount == 0)
+		{
+			data->recordAddress = address + x;
 		}
-		else {
-			if (baseRelative >= 0 && baseRelative <= BASE_MAX_RANGE){
-				bitFlags |= FLAG_B;
-			}
-			else {
-				displayError(ADDRESS_OUT_OF_RANGE, segments->operation);
-				exit(1);
-			}
-			pcRelative = baseRelative;
-		}
-		
-		if (pcRelative < 0){
-			pcRelative += 4096;
+		data->recordBytes[data->recordByteCount++] = bytes[x];
+		if (data->recordByteCount == data->recordLimit)
+		{
+			flushTextRecord(file, data);
 		}
+	}
+}
+
+// Orders text fragments by address, then by source position, for qsort()
+int compareTextFragments(const void* first, const void* second)
+{
+	const textFragment* left = (const textFragment*)first;
+	const textFragment* right = (const textFragment*)second;
 
-		bitFlags *= FORMAT_3_MULTIPLIER;
-		bitFlags += pcRelative;
-		return bitFlags;
+	if (left->address != right->address)
+	{
+		return left->address - right->address;
 	}
+	return left->order - right->order;
 }
 
-// Returns a new filename using the provided filename and extension
-char* createFilename(char* filename, const char* extension)
+// Computes the n, i, x, b, p and e bits and the displacement or address of a Format 3/4
+// instruction from the operand Pass 1 parsed, ready to be combined with the opcode encoding
+int computeFlagsAndAddress(controlSection* section, parsedOperand* operand, segment* segments)
 {
-	char* temp = (char*)malloc(sizeof(char) * strlen(filename) + 1);
-	
-	int n = strchr(filename, '.') - filename;
-	strncpy(temp, filename, n);
-	strcat(temp, extension);
-	return temp;
+	namePool* names = &section->names;
+	address* addresses = &section->addresses;
+	int bitFlags = operand->flags;
+
+    if (operand->flags & FLAG_E) { // Format 4; the loader adds external addresses
+		int symbolAddress = operand->numeric ? operand->value : operand->name != NO_NAME && names->external[operand->name] ? 0 : getNameAddress(names, operand->name, segments->operand);
+		return (bitFlags << 20) | (symbolAddress & 0xFFFFF);
+	}
+	if (operand->numeric) { // Numeric or empty, as for RSUB
+		return (bitFlags << 12) + operand->value;
+	}
+	if (operand->name != NO_NAME && names->external[operand->name]){
+		displayError(ILLEGAL_EXTERNAL_REFERENCE, names->names[operand->name]);
+		exit(1);
+	}
+
+	int symbolAddress = getNameAddress(names, operand->name, segments->operand);
+	int pcRelative = (symbolAddress - (addresses->current + addresses->increment));
+	int baseRelative = symbolAddress - addresses->base;
+	if (pcRelative >= PC_MIN_RANGE && pcRelative <= PC_MAX_RANGE){
+		bitFlags |= FLAG_P;
+	}
+	else {
+		if (baseRelative >= 0 && baseRelative <= BASE_MAX_RANGE){
+			bitFlags |= FLAG_B;
+		}
+		else {
+			displayError(ADDRESS_OUT_OF_RANGE, segments->operation);
+			exit(1);
+		}
+		pcRelative = baseRelative;
+	}
+
+	if (pcRelative < 0){
+		pcRelative += 4096;
+	}
+	return (bitFlags << 12) | pcRelative;
 }
 
-// Writes existing data to Object Data file and resets values
-void flushTextRecord(FILE* file, objectFileData* data, address* addresses)
+// Writes the open text record to the Object Data file and resets values
+void flushTextRecord(FILE* file, objectFileData* data)
 {
+	char recordType = data->recordType;
+
+	data->recordType = 'T';
 	writeToObjFile(file, *data);
-	data->recordAddress = addresses->current;
+	data->recordType = recordType;
+	data->recordAddress += data->recordByteCount;
 	data->recordByteCount = 0;
-	data->recordEntryCount = 0;
+}
+
+// Computes the n, i, x and e bits of a Format 3/4 instruction from the addressing character,
+// index suffix and format of its operand, so Pass 2 does not scan the operand again
+int getAddressingFlags(char* operand, int format)
+{
+	int flags = operand[0] == IMMEDIATE_CHARACTER ? FLAG_I : operand[0] == INDIRECT_CHARACTER ? FLAG_N : FLAG_I | FLAG_N;
+
+	if (strstr(operand, INDEX_STRING) != NULL)
+	{
+		flags |= FLAG_X;
+	}
+	return format == FORMAT_4 ? flags | FLAG_E : flags;
 }
 
 // Returns a hex byte containing the registers listed in the provided operand
@@ -219,35 +589,36 @@ int getRegisterValue(char registerName)
 	}
 }
 
-// Returns true if the provided string contains a numeric value; otherwise, false
-bool isNumeric(char* string)
+// Queues the listing line of a statement, or only records the statement and the size of its
+// object code in the listing map when the listing is deferred. BYTE and WORD statements pass
+// the bytes they store; other statements pass NULL
+void listStatement(controlSection* section, options* settings, listingWriter* listing, int line, int address, segment* segments, int opcode, unsigned char* bytes, int size)
 {
-	for(int x = 0; x < strlen(string); x++)
+	if (settings->listingMap)
 	{
-		if(!isdigit(string[x]))
-		{
-			return false;
-		}
+		addListingMapEntry(section, line, address, size);
+		return;
 	}
-	return true;
+	queueListingLine(listing, address, segments, opcode, bytes, size);
 }
 
 // Performs Pass 1 of the SIC/XE assembler
-void performPass1(symbol* symbolTable[], char* filename, address* addresses)
+void performPass1(controlSection* section, options* settings)
 {
-	char line[INPUT_BUF_SIZE];
-	FILE* file;
+	symbol** symbolTable = section->symbols;
+	sourceLines* source = &section->source;
+	address* addresses = &section->addresses;
+	referenceTable* references = settings->optimizeFormats || settings->analyzeBases ? &section->references : NULL;
+	symbol* entry;
 	int directiveType = 0;
-	
-	file = fopen(filename, "r");
-	if (!file)
-	{
-		displayError(FILE_NOT_FOUND, filename);
-		exit(-1);
-	}
+	int block = 0;
 
-	while (fgets(line, INPUT_BUF_SIZE, file))
+	resetProgramBlocks(section);
+	resetNamePool(&section->names, source->count);
+	for (int x = 0; x < source->count; x++)
 	{
+		char* line = source->lines[x];
+
 		// Test PC address value
 		if (addresses->current >= 0x100000)
 		{
@@ -269,7 +640,8 @@ void performPass1(symbol* symbolTable[], char* filename, address* addresses)
 		else
 		{
 			// Parse statement
-			segment* segments = prepareSegments(line);
+			segment statement;
+			segment* segments = prepareSegments(line, &statement);
 
 			// Test label segment for directive/opcode		
 			if (isDirective(segments->label) || isOpcode(segments->label))
@@ -280,19 +652,48 @@ void performPass1(symbol* symbolTable[], char* filename, address* addresses)
 			// Test operation segment for directive/opcode
 			if ((directiveType = (isDirective(segments->operation))))
 			{
-				if (isStartDirective(directiveType))
+				if (isStartDirective(directiveType) || isCsectDirective(directiveType))
 				{
-					addresses->start = addresses->current = strtol(segments->operand, NULL, 16);
+					// Control sections after the first are relocatable and start at zero
+					addresses->start = addresses->current = isStartDirective(directiveType) ? strtol(segments->operand, NULL, 16) : 0;
+					snprintf(section->name, NAME_SIZE, "%.*s", NAME_SIZE - 1, segments->label);
 					continue;
 				}
-				else
+				if (isUseDirective(directiveType))
+				{
+					// Each block keeps its own location counter until the blocks are placed
+					block = useProgramBlock(section, block, segments->operand, addresses->current);
+					addresses->current = section->blocks[block].current;
+					if (references != NULL)
+					{
+						references->block = block;
+					}
+				}
+				if (isExtrefDirective(directiveType))
+				{
+					addExternalReferences(section, segments->operand);
+				}
+				addresses->increment = getMemoryAmount(directiveType, segments->operand);
+				if (isBaseDirective(directiveType))
 				{
-					addresses->increment = getMemoryAmount(directiveType, segments->operand);
+					internOperand(&section->names, x, segments->operand);
+					if (references != NULL)
+					{
+						recordBaseDirective(references, segments->operand);
+					}
 				}
 			}
 			else if (isOpcode(segments->operation))
 			{
 				addresses->increment = getOpcodeFormat(segments->operation);
+				if (addresses->increment == FORMAT_3 || addresses->increment == FORMAT_4)
+				{
+					internOperand(&section->names, x, segments->operand)->flags = getAddressingFlags(segments->operand, addresses->increment);
+				}
+				if (references != NULL && addresses->increment == FORMAT_3)
+				{
+					recordReference(references, x, addresses->current, segments);
+				}
 			}
 			else
 			{
@@ -300,68 +701,96 @@ void performPass1(symbol* symbolTable[], char* filename, address* addresses)
 				exit(-1);
 			}
 			// Add label to symbolTable
-			if (strlen(segments->label) > 0)
+			if (strlen(segments->label) > 0 && (entry = insertSymbol(symbolTable, segments->label, addresses->current)) != NULL)
 			{
-				insertSymbol(symbolTable, segments->label, addresses->current);
+				entry->block = block;
+				defineName(&section->names, entry);
 			}
 			
 			// Adjust address
 			addresses->current += addresses->increment;
 		}
-		memset(line, '\0', INPUT_BUF_SIZE);
 	}
-	fclose(file);
+
+	// Program blocks - places each block behind the previous one and fixes up its symbols
+	placeProgramBlocks(section, block, addresses->current);
 }
 
 // Performs Pass 2 of the SIC/XE assembler
-void performPass2(struct symbol* symbolTable[], char* filename, address* addresses)
+void performPass2(controlSection* section, options* settings)
 {
-	objectFileData objectData = { 0, { 0x0 }, { "\0" }, 0, 0x0, 0, { 0 }, 0, '\0', 0x0 };
-	
-	char inData[INPUT_BUF_SIZE];
-	char objData[OUTPUT_BUF_SIZE];
-
-	FILE *fileIn, *fileLst, *fileObj;
+	objectFileData objectData = { .recordLimit = MAX_RECORD_BYTE_COUNT };
+	errorCleanup cleanup;
+	namePool* names = &section->names;
+	sourceLines* source = &section->source;
+	address* addresses = &section->addresses;
+	listingWriter listing;
+	FILE* fileObj = section->fileObj;
 	int directiveType = 0;
-		
-	char* lstFilename = createFilename(filename, ".lst");
-	char* objFilename = createFilename(filename, ".obj");
+	int block = 0;
+	bool ended = false;
 
-	fileIn = fopen(filename, "r");
-	if (!fileIn)
+	if (settings->extendedRecords)
 	{
-		displayError(FILE_NOT_FOUND, filename);
-		exit(-1);
+		objectData.recordLimit = MAX_EXTENDED_RECORD_BYTE_COUNT;
 	}
-	fileLst = fopen(lstFilename, "w");
-	fileObj = fopen(objFilename, "w");
+	rewindProgramBlocks(section);
+	pushErrorCleanup(&cleanup, releaseObjectData, &objectData);
+
+	// The listing is formatted by a writer thread while the instructions are encoded
+	startListingWriter(&listing, settings->skipListing || settings->listingMap ? NULL : section->fileLst, writeToLstFile, settings->jobs != 1);
 	
-	while (fgets(inData, INPUT_BUF_SIZE, fileIn))
+	for (int x = 0; x < source->count; x++)
 	{ 
+        char* inData = source->lines[x];
         objectData.recordType = 'T';
 
         // Call the prepareSegments() function to convert the statement into three segments
-        segment* segments = prepareSegments(inData);
+        segment statement;
+        segment* segments = prepareSegments(inData, &statement);
 
 		// Test if the operation is a directive
 		directiveType = isDirective(segments->operation);
 
         if (isDirective(segments->operation)) {
 
-            // Check if it's the START directive
-            if (isStartDirective(directiveType)) {
+            // Check if it's the START or CSECT directive
+            if (isStartDirective(directiveType) || isCsectDirective(directiveType)) {
                 objectData.recordType = 'H';
 
                 // Set programName, startAddress, recordAddress, programSize
-                strcpy(objectData.programName, segments->label);
+                strcpy(objectData.programName, section->name);
                 objectData.startAddress = addresses->start;
                 objectData.recordAddress = addresses->start;
-                objectData.programSize = addresses->current - addresses->start;
+                objectData.programSize = addresses->end - addresses->start;
 				addresses->current = addresses->start;
 
                 // Write to object and listing files
                 writeToObjFile(fileObj, objectData);
-                writeToLstFile(fileLst, addresses->current, segments, BLANK_INSTRUCTION);
+                listStatement(section, settings, &listing, x, addresses->current, segments, BLANK_INSTRUCTION, NULL, 0);
+
+				// Only the first control section names the first executable instruction
+				if (section->number > 0)
+				{
+					objectData.startAddress = -1;
+				}
+                continue;
+            }
+
+            // Check if it's the USE directive
+            if (isUseDirective(directiveType)) {
+
+                // Continue at the location counter of the selected program block
+                block = useProgramBlock(section, block, segments->operand, addresses->current);
+                addresses->current = section->blocks[block].current;
+                listStatement(section, settings, &listing, x, addresses->current, segments, BLANK_INSTRUCTION, NULL, 0);
+                continue;
+            }
+
+            // Check if it's the EXTDEF or EXTREF directive
+            if (isExtdefDirective(directiveType) || isExtrefDirective(directiveType)) {
+                writeExternalSymbols(fileObj, &objectData, section, segments, isExtdefDirective(directiveType) ? 'D' : 'R');
+                listStatement(section, settings, &listing, x, addresses->current, segments, BLANK_INSTRUCTION, NULL, 0);
                 continue;
             }
             
@@ -369,42 +798,41 @@ void performPass2(struct symbol* symbolTable[], char* filename, address* address
             if (isBaseDirective(directiveType)) {
 
                 // Get the BASE address and set it in addresses->base
-                addresses->base = getSymbolAddress(symbolTable, segments->operand);
+                addresses->base = getNameAddress(names, names->operands[x].name, segments->operand);
+				if (settings->crossReference)
+				{
+					recordNameUse(names, names->operands[x].name, addresses->current);
+				}
 
                 // Write to listing file
-                writeToLstFile(fileLst, addresses->current, segments, BLANK_INSTRUCTION);
+                listStatement(section, settings, &listing, x, addresses->current, segments, BLANK_INSTRUCTION, NULL, 0);
                 continue;
             }
             
             // Check if it's the END directive
             if (isEndDirective(isDirective(segments->operation))) {
 
-                // Check if there is an open text record and flush it
-                if (objectData.recordByteCount > 0){
-                    flushTextRecord(fileObj, &objectData, addresses);
-				}
+                // Write the held T records and close the last one
+                writeTextFragments(fileObj, &objectData);
+				objectData.recordType = 'M';
+				writeToObjFile(fileObj, objectData);
 				objectData.recordType = 'E';
 				
                 // Write to object and listing files
                 writeToObjFile(fileObj, objectData);
-                writeToLstFile(fileLst, addresses->current, segments, BLANK_INSTRUCTION);
+                listStatement(section, settings, &listing, x, addresses->current, segments, BLANK_INSTRUCTION, NULL, 0);
+				ended = true;
                 continue;
             }
             
             // Check if it's a RESB or RESW directive
             if (isReserveDirective(directiveType)) {
 
-                // Check if there is an open text record and flush it
-                if (objectData.recordByteCount > 0){
-                    flushTextRecord(fileObj, &objectData, addresses); 
-				}
-
-                // Write to listing file
-                writeToLstFile(fileLst, addresses->current, segments, BLANK_INSTRUCTION);
+                // Write to listing file; the open text record is closed by the next byte written
+                listStatement(section, settings, &listing, x, addresses->current, segments, BLANK_INSTRUCTION, NULL, 0);
 
                 // Update memory
                 addresses->increment = getMemoryAmount(directiveType, segments->operand);
-                objectData.recordAddress += addresses->increment;
 				addresses->current += addresses->increment;
                 continue;
             }
@@ -412,21 +840,13 @@ void performPass2(struct symbol* symbolTable[], char* filename, address* address
             // Check if it's a BYTE directive
             if (isDataDirective(directiveType)) {
 
-                // Check if there is an open text record and flush it if necessary
-				addresses->increment = getMemoryAmount(directiveType, segments->operand);
-                if (objectData.recordByteCount > (MAX_RECORD_BYTE_COUNT - addresses->increment)) {
-                    flushTextRecord(fileObj, &objectData, addresses);
-				}
-
-                // Get the byte value and add new record in the object data
-                int byteValue = getByteValue(directiveType, segments->operand);
-                objectData.recordEntries[objectData.recordEntryCount].numBytes = addresses->increment;
-                objectData.recordEntries[objectData.recordEntryCount].value = byteValue;
-                objectData.recordEntryCount++;
-                objectData.recordByteCount += addresses->increment;
+                // Get the byte value and add it to the text records
+				unsigned char bytes[OPERAND_SIZE];
+				addresses->increment = getDataBytes(directiveType, segments->operand, bytes);
+                addDataFragment(&objectData, addresses->current, bytes, addresses->increment);
 
-				// Write to listing file
-                writeToLstFile(fileLst, addresses->current, segments, byteValue);
+				// Write to listing file with the decoded bytes as its object code
+                listStatement(section, settings, &listing, x, addresses->current, segments, 0, bytes, addresses->increment);
 
 				// Update memory
 				addresses->current += addresses->increment;
@@ -435,74 +855,102 @@ void performPass2(struct symbol* symbolTable[], char* filename, address* address
         }
         
         // Check if the operation is an opcode
-        if (isOpcode(segments->operation)) {
-
-            // Get the opcode value and format
-            opcode op;
-			op.value = getOpcodeValue(segments->operation);
-            addresses->increment = getOpcodeFormat(segments->operation);
-           
-            // Align the opcode value with the instruction format
+        const opcode* op = getOpcode(segments->operation);
+        if (op != NULL) {
+			parsedOperand* operand = &names->operands[x];
+			int objectCode = op->encoding;
+
+            // Format 4 is a Format 3 opcode marked with '+', which Pass 1 recorded as the e bit
+            addresses->increment = op->format < FORMAT_3 ? op->format : operand->flags & FLAG_E ? FORMAT_4 : FORMAT_3;
+            if (op->format < FORMAT_3 && segments->operation[0] == '+') {
+				displayError(ILLEGAL_OPCODE_FORMAT, segments->operation);
+				exit(1);
+			}
+
+            // Combine the encoding of the opcode with the registers or the flags and address
             switch (addresses->increment) {
-				case -1:
-					displayError(ILLEGAL_OPCODE_FORMAT, segments->operation);
-                	exit(1);
-					break;
 				case 2:
-					op.value *= OPCODE_MULTIPLIER;
-					op.value += getRegisters(segments->operand);
+					objectCode |= getRegisters(segments->operand);
 					break;
 				case 3:
-					for(int i = 0; i < 2; i++){
-						op.value *= OPCODE_MULTIPLIER;
-					}
-					op.value += computeFlagsAndAddress(symbolTable, addresses, segments, addresses->increment);
+					objectCode |= computeFlagsAndAddress(section, operand, segments);
 					break;
 				case 4:
-					for(int i = 0; i < 3; i++){
-						op.value *= OPCODE_MULTIPLIER;
+					objectCode = (objectCode << 8) | computeFlagsAndAddress(section, operand, segments);
+
+					// The loader adds the external or relocated address to the 20-bit field
+					if (operand->name != NO_NAME && names->external[operand->name])
+					{
+						addModificationRecord(&objectData, addresses->current + 1, MODIFICATION_LENGTH, names->names[operand->name]);
+					}
+					else if (section->relocatable && operand->name != NO_NAME)
+					{
+						addModificationRecord(&objectData, addresses->current + 1, MODIFICATION_LENGTH, section->name);
 					}
-					op.value += computeFlagsAndAddress(symbolTable, addresses, segments, addresses->increment);
 					break;
 				default:
 					break;
 			}
 
-            // Check if there is an open text record and flush it if necessary
-            if (objectData.recordByteCount > (MAX_RECORD_BYTE_COUNT - addresses->increment)){
-                flushTextRecord(fileObj, &objectData, addresses);
+			// Operands were resolved above, so every symbol they name is known to be defined
+			if (settings->crossReference && addresses->increment >= 3 && operand->name != NO_NAME)
+			{
+				recordNameUse(names, operand->name, addresses->current);
 			}
 
-			// Add a record entry to the object data
-			objectData.recordEntries[objectData.recordEntryCount].numBytes = addresses->increment;
-			objectData.recordEntries[objectData.recordEntryCount].value = op.value;
-			objectData.recordEntryCount++;
-			objectData.recordByteCount += addresses->increment;
-			writeToLstFile(fileLst, addresses->current, segments, op.value);
+			// Add the instruction to the text records
+			addTextFragment(&objectData, addresses->current, objectCode, addresses->increment);
+			listStatement(section, settings, &listing, x, addresses->current, segments, objectCode, NULL, addresses->increment);
 
 			// Update memory
 			addresses->current += addresses->increment;
-
-			// Clear the statement buffer
-			memset(inData, '\0', INPUT_BUF_SIZE);
 		}
+	}
 
-		if (objectData.recordByteCount > (MAX_RECORD_BYTE_COUNT - addresses->increment)){
-			flushTextRecord(fileObj, &objectData, addresses);
+	// A control section followed by a CSECT ends without an END directive
+	if (!ended)
+	{
+		writeTextFragments(fileObj, &objectData);
+		objectData.recordType = 'M';
+		writeToObjFile(fileObj, objectData);
+		objectData.recordType = 'E';
+		writeToObjFile(fileObj, objectData);
+	}
+	stopListingWriter(&listing);
+
+	// The cross-reference is sorted and written once, after the last line of the section
+	if (settings->crossReference && !settings->skipListing)
+	{
+		if (ended)
+		{
+			fputc(NEW_LINE, section->fileLst);
 		}
+		writeCrossReference(section->fileLst, names);
 	}
-	fclose(fileIn);
-	fclose(fileLst);
-	fclose(fileObj);
+	popErrorCleanup(&cleanup);
+	releaseObjectData(&objectData);
+}
+
+// Releases the records Pass 2 collects for the object file; also registered with
+// pushErrorCleanup()
+void releaseObjectData(void* data)
+{
+	objectFileData* objectData = data;
+
+	releaseMemory(objectData->externalSymbols);
+	releaseMemory(objectData->fragments);
+	releaseMemory(objectData->fragmentBytes);
+	releaseMemory(objectData->modificationEntries);
 }
 
-// Separates a SIC/XE instruction into individual sections
-segment* prepareSegments(char* statement)
+// Separates a SIC/XE instruction into individual sections, stored in the provided segments
+// so each statement is parsed without an allocation
+segment* prepareSegments(char* statement, segment* temp)
 {
-	segment* temp = malloc(sizeof(segment));
+	memset(temp, 0, sizeof(segment));
 	strncpy(temp->label, statement, SEGMENT_SIZE - 1);
 	strncpy(temp->operation, statement + SEGMENT_SIZE - 1, SEGMENT_SIZE - 1);
-	strncpy(temp->operand, statement + (SEGMENT_SIZE - 1) * 2, SEGMENT_SIZE - 1);
+	strncpy(temp->operand, statement + (SEGMENT_SIZE - 1) * 2, OPERAND_SIZE - 1);
 
 	trim(temp->label); // Label
 	trim(temp->operation); // Operation
@@ -510,12 +958,12 @@ segment* prepareSegments(char* statement)
 	return temp;
 }
 
-// Removes spaces from the end of a segment value
+// Removes spaces and line endings from the end of a segment value
 void trim(char value[])
 {
-	for (int x = 0; x < SEGMENT_SIZE; x++)
+	for (int x = 0; value[x] != '\0'; x++)
 	{
-		if (value[x] == SPACE)
+		if (value[x] == SPACE || value[x] == NEW_LINE || value[x] == '\r')
 		{
 			value[x] = '\0';
 		}
@@ -523,13 +971,17 @@ void trim(char value[])
 }
 
 // Write SIC/XE instructions along with address and object code information of source code listing file
-void writeToLstFile(FILE* file, int address, segment* segments, int opcode)
+void writeToLstFile(FILE* file, int address, segment* segments, int opcode, unsigned char* bytes, int size)
 {
 	char ctrlString[27];
 	int length;
 	
 	int directiveType = isDirective(segments->operation);
 	if (isStartDirective(directiveType) || 
+		isCsectDirective(directiveType) || 
+		isExtdefDirective(directiveType) || 
+		isExtrefDirective(directiveType) || 
+		isUseDirective(directiveType) || 
 		isBaseDirective(directiveType) || 
 		isReserveDirective(directiveType))
 	{
@@ -539,27 +991,106 @@ void writeToLstFile(FILE* file, int address, segment* segments, int opcode)
 	{
 		fprintf(file, "%-8X%-8s%-8s%-8s", address, segments->label, segments->operation, segments->operand);
 	}
+	else if (isDataDirective(directiveType))
+	{
+		// Constants may be longer than an int, so their bytes are printed one at a time
+		fprintf(file, "%-8X%-8s%-8s%-8s    ", address, segments->label, segments->operation, segments->operand);
+		for (int x = 0; x < size; x++)
+		{
+			fprintf(file, "%02X", bytes[x]);
+		}
+		fputc(NEW_LINE, file);
+	}
 	else
 	{
-		if (isDataDirective(directiveType))
+		length = getOpcodeFormat(segments->operation) * 2;
+		sprintf(ctrlString, "%%-8X%%-8s%%-8s%%-8s    %%0%dX\n", length);
+
+		fprintf(file, ctrlString, address, segments->label, segments->operation, segments->operand, opcode);
+	}
+}
+
+// Formats a statement of a listing map as its listing line, with the object code read back from
+// the object file
+void writeMappedListingLine(FILE* file, int address, char* statement, unsigned char* bytes, int size)
+{
+	segment segments;
+	int objectCode = 0;
+
+	for (int x = 0; x < size && x < FORMAT_4; x++)
+	{
+		objectCode = (objectCode << 8) | bytes[x];
+	}
+	writeToLstFile(file, address, prepareSegments(statement, &segments), objectCode, bytes, size);
+}
+
+// Writes the D or R record for the symbols listed by an EXTDEF or EXTREF directive
+void writeExternalSymbols(FILE* file, objectFileData* data, controlSection* section, segment* segments, char recordType)
+{
+	char* operand = segments->operand;
+	int length = 0;
+
+	data->externalSymbolCount = 0;
+	data->externalSymbols = resizeMemory(data->externalSymbols, sizeof(externalSymbol) * (strlen(operand) / 2 + 1));
+	for (int x = 0; ; x++)
+	{
+		if (operand[x] == ',' || operand[x] == '\0')
 		{
-			length = getMemoryAmount(directiveType, segments->operand) * 2;
+			externalSymbol* entry = &data->externalSymbols[data->externalSymbolCount];
+			entry->name[length] = '\0';
+			if (length > 0)
+			{
+				entry->address = 0;
+				if (recordType == 'D')
+				{
+					symbol* definition = findSymbol(section->symbols, entry->name);
+					if (definition == NULL)
+					{
+						displayError(UNKNOWN_SYMBOL, entry->name);
+						exit(1);
+					}
+					entry->address = definition->address;
+				}
+				data->externalSymbolCount++;
+			}
+			length = 0;
+			if (operand[x] == '\0')
+			{
+				break;
+			}
 		}
-		else
+		else if (length < NAME_SIZE - 1)
 		{
-			length = getOpcodeFormat(segments->operation) * 2;
+			data->externalSymbols[data->externalSymbolCount].name[length++] = operand[x];
 		}
-		sprintf(ctrlString, "%%-8X%%-8s%%-8s%%-8s    %%0%dX\n", length);
+	}
 
-		fprintf(file, ctrlString, address, segments->label, segments->operation, segments->operand, opcode);
+	data->recordType = recordType;
+	writeToObjFile(file, *data);
+	data->recordType = 'T';
+}
+
+// Writes the held instructions and constants as T records in address order, so program
+// blocks used out of order still produce ascending, fully packed records
+void writeTextFragments(FILE* file, objectFileData* data)
+{
+	qsort(data->fragments, data->fragmentCount, sizeof(textFragment), compareTextFragments);
+	for (int x = 0; x < data->fragmentCount; x++)
+	{
+		appendToTextRecord(file, data, data->fragments[x].address, &data->fragmentBytes[data->fragments[x].offset], data->fragments[x].numBytes);
+	}
+	data->fragmentCount = 0;
+	data->fragmentByteCount = 0;
+
+	if (data->recordByteCount > 0)
+	{
+		flushTextRecord(file, data);
 	}
 }
 
 // Write object code data to object code file
 void writeToObjFile(FILE* file, objectFileData data)
 {
-	char ctrlString[27];
-	
 	if (data.recordType == 'H')
 	{
 		fprintf(file, "H%-6s%06X%06X\n", data.programName, data.startAddress, data.programSize);
@@ -567,22 +1098,49 @@ void writeToObjFile(FILE* file, objectFileData data)
 	else if (data.recordType == 'T')
 	{
 		fprintf(file, "T%06X%02X", data.recordAddress, data.recordByteCount);
-		for (int x = 0; x < data.recordEntryCount; x++)
+		for (int x = 0; x < data.recordByteCount; x++)
 		{
-			sprintf(ctrlString, "%%0%dX", data.recordEntries[x].numBytes * 2);
-			fprintf(file, ctrlString, data.recordEntries[x].value);
+			fprintf(file, "%02X", data.recordBytes[x]);
 		}
 		fprintf(file, "\n");
 	}
+	else if (data.recordType == 'D' || data.recordType == 'R')
+	{
+		// D records hold six names and addresses per line; R records hold twelve names
+		int perRecord = data.recordType == 'D' ? MAX_DEFINITIONS_PER_RECORD : MAX_REFERENCES_PER_RECORD;
+		for (int x = 0; x < data.externalSymbolCount; x++)
+		{
+			if (x % perRecord == 0)
+			{
+				fprintf(file, "%c", data.recordType);
+			}
+			fprintf(file, "%-6s", data.externalSymbols[x].name);
+			if (data.recordType == 'D')
+			{
+				fprintf(file, "%06X", data.externalSymbols[x].address);
+			}
+			if (x % perRecord == perRecord - 1 || x == data.externalSymbolCount - 1)
+			{
+				fprintf(file, "\n");
+			}
+		}
+	}
 	else if (data.recordType == 'E')
 	{
-		fprintf(file, "E%06X", data.startAddress);
+		if (data.startAddress < 0)
+		{
+			fprintf(file, "E");
+		}
+		else
+		{
+			fprintf(file, "E%06X", data.startAddress);
+		}
 	}
 	else if (data.recordType == 'M')
 	{
 		for (int x = 0; x < data.modificationCount; x++)
 		{
-			fprintf(file, "M%06X05+%s\n", data.modificationEntries[x], data.programName);
+			fprintf(file, "M%06X%02X+%s\n", data.modificationEntries[x].address, data.modificationEntries[x].length, data.modificationEntries[x].symbol);
 		}
 	}
 }
\ No newline at end of file
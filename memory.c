@@ -0,0 +1,215 @@
+#define _GNU_SOURCE // fopencookie()
+#include "headers.h"
+#include <stddef.h>
+
+// Every block starts with a header holding its size, padded to keep the caller's memory aligned
+#define MEMORY_HEADER_SIZE sizeof(max_align_t)
+#define MEMORY_STREAM_INITIAL_SIZE 1024
+
+// Used to grow the text written to a stream opened by openMemoryStream()
+typedef struct memoryStream
+{
+	char** text;
+	size_t* size;
+	size_t capacity;
+} memoryStream;
+
+static memoryUsage usage = { 0, 0, 0, 0, 0 };
+static size_t memoryLimit = 0; // Zero when the memory is not limited
+
+void* attachMemoryHeader(void* block, size_t size);
+void chargeMemory(size_t size);
+int closeMemoryStream(void* cookie);
+void reportMemoryLimit(size_t size);
+ssize_t writeMemoryStream(void* cookie, const char* data, size_t length);
+
+// Allocates a block of memory that is counted in the memory usage
+// Ends the process if the block would exceed the memory limit or cannot be allocated
+void* allocateMemory(size_t size)
+{
+	chargeMemory(size);
+	return attachMemoryHeader(malloc(MEMORY_HEADER_SIZE + size), size);
+}
+
+// Allocates a zeroed array that is counted in the memory usage
+void* allocateZeroedMemory(size_t count, size_t size)
+{
+	if (size > 0 && count > SIZE_MAX / size - MEMORY_HEADER_SIZE)
+	{
+		reportMemoryLimit(SIZE_MAX);
+	}
+	chargeMemory(count * size);
+	return attachMemoryHeader(calloc(1, MEMORY_HEADER_SIZE + count * size), count * size);
+}
+
+// Stores the size in the header of a newly allocated block
+// Returns the memory that follows the header
+void* attachMemoryHeader(void* block, size_t size)
+{
+	if (block == NULL)
+	{
+		__atomic_sub_fetch(&usage.current, size, __ATOMIC_RELAXED);
+		reportMemoryLimit(size);
+	}
+	*(size_t*)block = size;
+	return (char*)block + MEMORY_HEADER_SIZE;
+}
+
+// Adds an allocation to the memory usage. The counters are shared by the threads that
+// assemble control sections, so they are updated atomically
+void chargeMemory(size_t size)
+{
+	size_t current = __atomic_add_fetch(&usage.current, size, __ATOMIC_RELAXED);
+	size_t peak = __atomic_load_n(&usage.peak, __ATOMIC_RELAXED);
+
+	if (memoryLimit > 0 && current > memoryLimit)
+	{
+		__atomic_sub_fetch(&usage.current, size, __ATOMIC_RELAXED);
+		reportMemoryLimit(size);
+	}
+	while (current > peak && !__atomic_compare_exchange_n(&usage.peak, &peak, current, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+	{
+	}
+	__atomic_add_fetch(&usage.total, size, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&usage.allocations, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&usage.live, 1, __ATOMIC_RELAXED);
+}
+
+// Releases the state of a stream opened by openMemoryStream(); the text stays with the caller
+int closeMemoryStream(void* cookie)
+{
+	releaseMemory(cookie);
+	return 0;
+}
+
+// Prints the memory used since the provided usage was taken, and the memory still allocated
+void displayMemoryUsage(FILE* file, memoryUsage* start)
+{
+	memoryUsage end = getMemoryUsage();
+
+	fprintf(file, "\nPeak Memory (bytes): %zu\nAllocated Memory (bytes): %zu in %zu allocations\n", end.peak, end.total - start->total, end.allocations - start->allocations);
+	fprintf(file, "Residual Memory (bytes): %zu in %zu allocations\n", end.current - start->current, end.live - start->live);
+}
+
+// Returns a counted copy of the string
+char* duplicateString(const char* string)
+{
+	char* copy = allocateMemory(strlen(string) + 1);
+
+	strcpy(copy, string);
+	return copy;
+}
+
+// Returns the current memory usage
+memoryUsage getMemoryUsage(void)
+{
+	memoryUsage current;
+
+	current.current = __atomic_load_n(&usage.current, __ATOMIC_RELAXED);
+	current.peak = __atomic_load_n(&usage.peak, __ATOMIC_RELAXED);
+	current.total = __atomic_load_n(&usage.total, __ATOMIC_RELAXED);
+	current.allocations = __atomic_load_n(&usage.allocations, __ATOMIC_RELAXED);
+	current.live = __atomic_load_n(&usage.live, __ATOMIC_RELAXED);
+	return current;
+}
+
+// Opens a stream like open_memstream() whose text is counted in the memory usage and limited by
+// the memory limit. As the stream is written, text points to the NUL-terminated text and size to
+// its length; the caller releases the text with releaseMemory() after closing the stream
+FILE* openMemoryStream(char** text, size_t* size)
+{
+	memoryStream* stream = allocateMemory(sizeof(memoryStream));
+	cookie_io_functions_t functions = { NULL, writeMemoryStream, NULL, closeMemoryStream };
+
+	stream->text = text;
+	stream->size = size;
+	stream->capacity = MEMORY_STREAM_INITIAL_SIZE;
+	*text = allocateMemory(stream->capacity);
+	**text = '\0';
+	*size = 0;
+	return fopencookie(stream, "w", functions);
+}
+
+// Releases a block allocated by allocateMemory(), allocateZeroedMemory() or resizeMemory()
+void releaseMemory(void* memory)
+{
+	if (memory == NULL)
+	{
+		return;
+	}
+	void* block = (char*)memory - MEMORY_HEADER_SIZE;
+	__atomic_sub_fetch(&usage.current, *(size_t*)block, __ATOMIC_RELAXED);
+	__atomic_sub_fetch(&usage.live, 1, __ATOMIC_RELAXED);
+	free(block);
+}
+
+// Ends the process with an error when an allocation cannot be made
+void reportMemoryLimit(size_t size)
+{
+	char value[32];
+
+	snprintf(value, sizeof(value), "%zu", size);
+	displayError(MEMORY_LIMIT_EXCEEDED, value);
+	exit(-1);
+}
+
+// Starts measuring the peak memory usage again from the current usage
+void resetMemoryPeak(void)
+{
+	__atomic_store_n(&usage.peak, __atomic_load_n(&usage.current, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+}
+
+// Changes the size of a counted block, allocating it when memory is NULL
+void* resizeMemory(void* memory, size_t size)
+{
+	if (memory == NULL)
+	{
+		return allocateMemory(size);
+	}
+
+	void* block = (char*)memory - MEMORY_HEADER_SIZE;
+	size_t previous = *(size_t*)block;
+	if (size > previous)
+	{
+		chargeMemory(size - previous);
+		__atomic_sub_fetch(&usage.allocations, 1, __ATOMIC_RELAXED);
+		__atomic_sub_fetch(&usage.live, 1, __ATOMIC_RELAXED);
+	}
+	else
+	{
+		__atomic_sub_fetch(&usage.current, previous - size, __ATOMIC_RELAXED);
+	}
+	if ((block = realloc(block, MEMORY_HEADER_SIZE + size)) == NULL)
+	{
+		reportMemoryLimit(size);
+	}
+	*(size_t*)block = size;
+	return (char*)block + MEMORY_HEADER_SIZE;
+}
+
+// Limits the memory the assembler may hold at once; zero removes the limit
+void setMemoryLimit(size_t limit)
+{
+	memoryLimit = limit;
+}
+
+// Appends the data a stream opened by openMemoryStream() flushes to its text, doubling the text
+// when it is full
+// Returns the number of bytes written
+ssize_t writeMemoryStream(void* cookie, const char* data, size_t length)
+{
+	memoryStream* stream = cookie;
+
+	if (*stream->size + length + 1 > stream->capacity)
+	{
+		while (*stream->size + length + 1 > stream->capacity)
+		{
+			stream->capacity *= 2;
+		}
+		*stream->text = resizeMemory(*stream->text, stream->capacity);
+	}
+	memcpy(*stream->text + *stream->size, data, length);
+	*stream->size += length;
+	(*stream->text)[*stream->size] = '\0';
+	return length;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+// Used to report the memory allocated by the assembler
+typedef struct memoryUsage
+{
+	size_t current;     // Bytes allocated and not yet released
+	size_t peak;        // Highest value of current since the last resetMemoryPeak()
+	size_t total;       // Bytes allocated since the process started
+	size_t allocations; // Allocations since the process started
+	size_t live;        // Allocations not yet released
+} memoryUsage;
+
+void* allocateMemory(size_t size);
+void* allocateZeroedMemory(size_t count, size_t size);
+void displayMemoryUsage(FILE* file, memoryUsage* start);
+char* duplicateString(const char* string);
+memoryUsage getMemoryUsage(void);
+FILE* openMemoryStream(char** text, size_t* size);
+void releaseMemory(void* memory);
+void resetMemoryPeak(void);
+void* resizeMemory(void* memory, size_t size);
+void setMemoryLimit(size_t limit);
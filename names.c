@@ -0,0 +1,202 @@
+#include "headers.h"
+
+#define CROSS_REFERENCE_COLUMNS 8
+#define INITIAL_NAME_CAPACITY 64
+
+int compareNames(const void* first, const void* second);
+uint32_t hashName(char* name);
+void growNamePool(namePool* pool);
+
+// Orders pointers to names alphabetically for qsort()
+int compareNames(const void* first, const void* second)
+{
+	return strcmp(*(const char* const*)first, *(const char* const*)second);
+}
+
+// Records the symbol table entry defined for a label
+void defineName(namePool* pool, symbol* entry)
+{
+	int name = internName(pool, entry->name);
+
+	pool->symbols[name] = entry;
+}
+
+// Releases the names, index and statement operands of the pool
+void freeNamePool(namePool* pool)
+{
+	releaseMemory(pool->names);
+	releaseMemory(pool->symbols);
+	releaseMemory(pool->external);
+	for (int x = 0; x < pool->count; x++)
+	{
+		releaseMemory(pool->uses[x].addresses);
+	}
+	releaseMemory(pool->uses);
+	releaseMemory(pool->slots);
+	releaseMemory(pool->operands);
+	memset(pool, 0, sizeof(namePool));
+}
+
+// Returns the address of the symbol with the provided ID; the operand text is only used to
+// report a symbol that was never defined
+int getNameAddress(namePool* pool, int name, char* operand)
+{
+	if (name == NO_NAME || pool->symbols[name] == NULL)
+	{
+		displayError(UNKNOWN_SYMBOL, name == NO_NAME ? operand : pool->names[name]);
+		exit(-1);
+	}
+	return pool->symbols[name]->address;
+}
+
+// Doubles the capacity of the pool and rebuilds the index, which is kept at most half full
+void growNamePool(namePool* pool)
+{
+	pool->capacity = pool->capacity > 0 ? pool->capacity * 2 : INITIAL_NAME_CAPACITY;
+	pool->names = resizeMemory(pool->names, sizeof(*pool->names) * pool->capacity);
+	pool->symbols = resizeMemory(pool->symbols, sizeof(symbol*) * pool->capacity);
+	pool->external = resizeMemory(pool->external, sizeof(bool) * pool->capacity);
+	pool->uses = resizeMemory(pool->uses, sizeof(nameUses) * pool->capacity);
+
+	pool->slotCount = pool->capacity * 2;
+	releaseMemory(pool->slots);
+	pool->slots = allocateZeroedMemory(pool->slotCount, sizeof(int));
+	for (int x = 0; x < pool->count; x++)
+	{
+		uint32_t slot = hashName(pool->names[x]) & (pool->slotCount - 1);
+		while (pool->slots[slot] != 0)
+		{
+			slot = (slot + 1) & (pool->slotCount - 1);
+		}
+		pool->slots[slot] = x + 1;
+	}
+}
+
+// Computes the 32-bit FNV-1a hash of a symbol name
+uint32_t hashName(char* name)
+{
+	return hashBytes(FNV32_OFFSET_BASIS, name, strnlen(name, NAME_SIZE));
+}
+
+// Returns the ID of the provided name, adding the name to the pool the first time it is seen
+int internName(namePool* pool, char* name)
+{
+	uint32_t slot;
+
+	if (pool->count == pool->capacity)
+	{
+		growNamePool(pool);
+	}
+	slot = hashName(name) & (pool->slotCount - 1);
+	while (pool->slots[slot] != 0)
+	{
+		if (strncmp(pool->names[pool->slots[slot] - 1], name, NAME_SIZE - 1) == 0)
+		{
+			return pool->slots[slot] - 1;
+		}
+		slot = (slot + 1) & (pool->slotCount - 1);
+	}
+
+	strncpy(pool->names[pool->count], name, NAME_SIZE - 1);
+	pool->names[pool->count][NAME_SIZE - 1] = '\0';
+	pool->symbols[pool->count] = NULL;
+	pool->external[pool->count] = false;
+	memset(&pool->uses[pool->count], 0, sizeof(nameUses));
+	pool->slots[slot] = pool->count + 1;
+	return pool->count++;
+}
+
+// Records the operand of a statement without its addressing characters: a number, or the ID of
+// the symbol it names. The addressing flags are left for the caller
+// Returns the parsed operand
+parsedOperand* internOperand(namePool* pool, int line, char* operand)
+{
+	parsedOperand* parsed = &pool->operands[line];
+	char name[OPERAND_SIZE];
+
+	getOperandSymbol(operand, name);
+	parsed->flags = 0;
+	parsed->numeric = strspn(name, "0123456789") == strlen(name);
+	parsed->value = parsed->numeric ? (int)strtol(name, NULL, 10) : 0;
+	parsed->name = strlen(name) > 0 && !isdigit(name[0]) ? internName(pool, name) : NO_NAME;
+	return parsed;
+}
+
+// Appends the address of a statement to the uses of the symbol it names
+void recordNameUse(namePool* pool, int name, int address)
+{
+	nameUses* uses = &pool->uses[name];
+
+	if (uses->count == uses->capacity)
+	{
+		uses->capacity = uses->capacity > 0 ? uses->capacity * 2 : 4;
+		uses->addresses = resizeMemory(uses->addresses, sizeof(int) * uses->capacity);
+	}
+	uses->addresses[uses->count++] = address;
+}
+
+// Prepares the pool for a Pass 1 over the provided number of statements. Names keep their IDs
+// from a previous pass, but the definitions, external flags and statement operands are cleared
+void resetNamePool(namePool* pool, int lineCount)
+{
+	if (lineCount > pool->operandCapacity)
+	{
+		pool->operandCapacity = lineCount;
+		pool->operands = resizeMemory(pool->operands, sizeof(parsedOperand) * lineCount);
+	}
+	for (int x = 0; x < lineCount; x++)
+	{
+		pool->operands[x] = (parsedOperand){ 0, NO_NAME, 0, true };
+	}
+	for (int x = 0; x < pool->count; x++)
+	{
+		pool->symbols[x] = NULL;
+		pool->external[x] = false;
+		pool->uses[x].count = 0;
+	}
+}
+
+// Writes the defined and referenced symbols in alphabetical order, each with its address, or
+// EXTREF if another section defines it, and the addresses of the statements that use it
+void writeCrossReference(FILE* file, namePool* pool)
+{
+	const char** sorted = allocateMemory(sizeof(char*) * (pool->count + 1));
+	int count = 0;
+
+	for (int x = 0; x < pool->count; x++)
+	{
+		if (pool->symbols[x] != NULL || pool->uses[x].count > 0)
+		{
+			sorted[count++] = pool->names[x];
+		}
+	}
+	qsort(sorted, count, sizeof(char*), compareNames);
+
+	fprintf(file, "\nCROSS REFERENCE\n%-8s%-8s%s\n", "Symbol", "Value", "References");
+	for (int x = 0; x < count; x++)
+	{
+		int name = (int)((const char(*)[NAME_SIZE])sorted[x] - pool->names);
+		nameUses* uses = &pool->uses[name];
+		char value[SEGMENT_SIZE] = "";
+
+		if (pool->symbols[name] != NULL)
+		{
+			snprintf(value, SEGMENT_SIZE, "%X", pool->symbols[name]->address);
+		}
+		else if (pool->external[name])
+		{
+			strcpy(value, "EXTREF");
+		}
+		fprintf(file, "%-8s%s", sorted[x], uses->count > 0 ? "" : value);
+		for (int y = 0; y < uses->count; y++)
+		{
+			if (y % CROSS_REFERENCE_COLUMNS == 0)
+			{
+				fprintf(file, y == 0 ? "%-8s" : "\n%16s", y == 0 ? value : "");
+			}
+			fprintf(file, (y + 1) % CROSS_REFERENCE_COLUMNS != 0 && y + 1 < uses->count ? "%-8X" : "%X", uses->addresses[y]);
+		}
+		fprintf(file, "\n");
+	}
+	releaseMemory(sorted);
+}
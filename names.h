@@ -0,0 +1,46 @@
+#pragma once
+
+#define NO_NAME -1
+
+// Used to store the addresses of the statements whose operand names one symbol
+typedef struct nameUses
+{
+	int* addresses;
+	int count;
+	int capacity;
+} nameUses;
+
+// Used to store the operand of a statement as parsed once by Pass 1
+typedef struct parsedOperand
+{
+	int flags;    // n, i, x and e bits of a Format 3/4 instruction
+	int name;     // ID of the symbol the operand names; NO_NAME if none
+	int value;    // Value of a numeric operand
+	bool numeric; // True when the operand is a number or empty
+} parsedOperand;
+
+// Used to intern the symbol names of a control section as dense integer IDs. Pass 1 gives
+// every label and operand symbol an ID, so Pass 2 resolves an operand with an array index
+// instead of hashing and comparing its name
+typedef struct namePool
+{
+	char (*names)[NAME_SIZE]; // Name of each ID
+	symbol** symbols;         // Symbol table entry of each ID; NULL while undefined
+	bool* external;           // True for the IDs listed by an EXTREF directive
+	nameUses* uses;           // Statements of each ID recorded by Pass 2 for the cross-reference
+	int count;
+	int capacity;
+	int* slots;               // Open addressing index of the names; ID + 1, or 0 if empty
+	int slotCount;
+	parsedOperand* operands;  // Operand of each statement
+	int operandCapacity;
+} namePool;
+
+void defineName(namePool* pool, symbol* entry);
+void freeNamePool(namePool* pool);
+int getNameAddress(namePool* pool, int name, char* operand);
+int internName(namePool* pool, char* name);
+parsedOperand* internOperand(namePool* pool, int line, char* operand);
+void recordNameUse(namePool* pool, int name, int address);
+void resetNamePool(namePool* pool, int lineCount);
+void writeCrossReference(FILE* file, namePool* pool);
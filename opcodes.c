@@ -1,26 +1,44 @@
 #include "headers.h"
 
-#define OPCODE_ARRAY_SIZE 50
+#define OPCODE_ARRAY_SIZE OPCODE_COUNT
+#define OPCODE_DECODE(name, format, value) [value] = OPCODE_##name + 1,
+#define OPCODE_ENTRY(name, format, value) { #name, format, value, (value) << (((format) - 1) * 8) },
+#define OPCODE_INDEX(name, format, value) OPCODE_##name,
 
 bool isFormat4Instruction(char* opcode);
 int searchOpcodes(char* opcode);
 
-// A format of 3 indicates a 3- or 4-byte instruction
-opcode opcodes[OPCODE_ARRAY_SIZE] = { 
-	{"ADD",3,0x18}, {"ADDR",2,0x90},  {"AND",3,0x40},   {"CLEAR",2,0xB4},
-	{"COMP",3,0x28},{"COMPR",2,0xA0}, {"DIV",3,0x24},   {"DIVR",2,0x9C},
-	{"FIX",1,0xC4}, {"HIO",1,0xF4},   {"J",3,0x3C},     {"JEQ",3,0x30},
-	{"JGT",3,0x34}, {"JLT",3,0x38},   {"JSUB",3,0x48},  {"LDA",3,0x00},
-	{"LDB",3,0x68}, {"LDCH",3,0x50},  {"LDL",3,0x08},   {"LDS",3,0x6C},
-	{"LDT",3,0x74}, {"LDX",3,0x04},   {"LPS",3,0xD0},   {"MUL",3,0x20},
-	{"MULR",2,0x98},{"OR",3,0x44},    {"RD",3,0xD8},    {"RMO",2,0xAC},
-	{"RSUB",3,0x4C},{"SHIFTL",2,0xA4},{"SHIFTR",2,0xA8},{"SIO",1,0xF0},
-	{"SSK",3,0xEC}, {"STA",3,0x0C},   {"STB",3,0x78},   {"STCH",3,0x54},
-	{"STI",3,0xD4}, {"STL",3,0x14},   {"STS",3,0x7C},   {"STSW",3,0xE8},
-	{"STT",3,0x84}, {"STX",3,0x10},   {"SUB",3,0x1C},   {"SUBR",2,0x94},
-	{"SVC",2,0xB0}, {"TD",3,0xE0},    {"TIO",1,0xF8},   {"TIX",3,0x2C},
-	{"TIXR",2,0xB8},{"WD",3,0xDC}
-};
+// Position of each opcode in the opcodes array
+enum opcodeIndexes { OPCODE_LIST(OPCODE_INDEX) OPCODE_COUNT };
+
+opcode opcodes[OPCODE_ARRAY_SIZE] = { OPCODE_LIST(OPCODE_ENTRY) };
+
+// Maps the first byte of an instruction, with the n and i bits cleared, to its opcodes
+// index + 1; 0 if the byte does not start an instruction. Built from OPCODE_LIST by the compiler
+static const unsigned char decodeTable[256] = { OPCODE_LIST(OPCODE_DECODE) };
+
+// Finds the opcode an instruction starts with. The n and i bits of Format 3/4 opcodes are
+// ignored; Format 1 and Format 2 opcodes must match exactly
+// Returns the opcode; NULL if the byte does not start an instruction
+const opcode* decodeOpcode(unsigned char value)
+{
+	int index = decodeTable[value & 0xFC];
+
+	if (index == 0 || (opcodes[index - 1].format < 3 && opcodes[index - 1].value != value))
+	{
+		return NULL;
+	}
+	return &opcodes[index - 1];
+}
+
+// Finds the opcode of an operation, which may be marked with '+' for Format 4
+// Returns the opcode; NULL if the operation is not an opcode
+const opcode* getOpcode(char* opcode)
+{
+	int x = searchOpcodes(isFormat4Instruction(opcode) ? &opcode[1] : opcode);
+
+	return x >= 0 ? &opcodes[x] : NULL;
+}
 
 // Returns the format of the provided opcode
 int getOpcodeFormat(char* opcode)
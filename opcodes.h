@@ -10,13 +10,33 @@
 **********************************************/
 #pragma once
 
+// Every SIC/XE opcode as X(name, format, value), sorted by name for searchOpcodes().
+// A format of 3 indicates a 3- or 4-byte instruction
+#define OPCODE_LIST(X) \
+	X(ADD,3,0x18)  X(ADDR,2,0x90)  X(AND,3,0x40)   X(CLEAR,2,0xB4) \
+	X(COMP,3,0x28) X(COMPR,2,0xA0) X(DIV,3,0x24)   X(DIVR,2,0x9C)  \
+	X(FIX,1,0xC4)  X(HIO,1,0xF4)   X(J,3,0x3C)     X(JEQ,3,0x30)   \
+	X(JGT,3,0x34)  X(JLT,3,0x38)   X(JSUB,3,0x48)  X(LDA,3,0x00)   \
+	X(LDB,3,0x68)  X(LDCH,3,0x50)  X(LDL,3,0x08)   X(LDS,3,0x6C)   \
+	X(LDT,3,0x74)  X(LDX,3,0x04)   X(LPS,3,0xD0)   X(MUL,3,0x20)   \
+	X(MULR,2,0x98) X(OR,3,0x44)    X(RD,3,0xD8)    X(RMO,2,0xAC)   \
+	X(RSUB,3,0x4C) X(SHIFTL,2,0xA4) X(SHIFTR,2,0xA8) X(SIO,1,0xF0) \
+	X(SSK,3,0xEC)  X(STA,3,0x0C)   X(STB,3,0x78)   X(STCH,3,0x54)  \
+	X(STI,3,0xD4)  X(STL,3,0x14)   X(STS,3,0x7C)   X(STSW,3,0xE8)  \
+	X(STT,3,0x84)  X(STX,3,0x10)   X(SUB,3,0x1C)   X(SUBR,2,0x94)  \
+	X(SVC,2,0xB0)  X(TD,3,0xE0)    X(TIO,1,0xF8)   X(TIX,3,0x2C)   \
+	X(TIXR,2,0xB8) X(WD,3,0xDC)
+
 typedef struct opcode
 {
 	char name[NAME_SIZE];
 	int format; // Instruction format: 1, 2 or 3/4 bytes
 	int value;
+	int encoding; // Value shifted into the first byte of its format; Format 4 shifts it 8 bits more
 } opcode;
 
+const opcode* decodeOpcode(unsigned char value);
+const opcode* getOpcode(char* opcode);
 int getOpcodeFormat(char* opcode);
 int getOpcodeValue(char* opcode);
 bool isOpcode(char* string);
\ No newline at end of file
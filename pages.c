@@ -0,0 +1,96 @@
+#include "headers.h"
+
+#define MEMORY_PAGE_SHIFT 12
+
+memoryPage* allocatePage(pagedMemory* memory, memoryPage* source);
+void releasePage(memoryPage* page);
+
+// Allocates a page for the memory, holding a copy of the source page or zeros if there is none
+// Returns the page
+memoryPage* allocatePage(pagedMemory* memory, memoryPage* source)
+{
+	memoryPage* page = source != NULL ? allocateMemory(sizeof(memoryPage)) : allocateZeroedMemory(1, sizeof(memoryPage));
+
+	if (source != NULL)
+	{
+		memcpy(page->bytes, source->bytes, MEMORY_PAGE_SIZE);
+	}
+	page->references = 1;
+	memory->pageCount++;
+	return page;
+}
+
+// Makes the memory share every page of the snapshot. Neither is copied until it is written, so
+// a clone costs one pointer per page, and the snapshot must not be written while clones exist
+void clonePagedMemory(pagedMemory* memory, pagedMemory* snapshot)
+{
+	for (int x = 0; x < MEMORY_PAGE_COUNT; x++)
+	{
+		memory->pages[x] = snapshot->pages[x];
+		if (memory->pages[x] != NULL)
+		{
+			__atomic_add_fetch(&memory->pages[x]->references, 1, __ATOMIC_RELAXED);
+		}
+	}
+	memory->pageCount = 0;
+}
+
+// Returns the number of pages the memory can read without reading zeros, shared or not
+int countMappedPages(pagedMemory* memory)
+{
+	int count = 0;
+
+	for (int x = 0; x < MEMORY_PAGE_COUNT; x++)
+	{
+		count += memory->pages[x] != NULL;
+	}
+	return count;
+}
+
+// Returns the byte at the address, which the caller has checked is in memory
+int readMemoryByte(pagedMemory* memory, int address)
+{
+	memoryPage* page = memory->pages[address >> MEMORY_PAGE_SHIFT];
+
+	return page != NULL ? page->bytes[address & (MEMORY_PAGE_SIZE - 1)] : 0;
+}
+
+// Drops one reference to the page, releasing it when no memory shares it any longer
+void releasePage(memoryPage* page)
+{
+	if (page != NULL && __atomic_sub_fetch(&page->references, 1, __ATOMIC_ACQ_REL) == 0)
+	{
+		releaseMemory(page);
+	}
+}
+
+// Releases the pages of the memory; pages still shared with a snapshot or clone are kept
+void releasePagedMemory(pagedMemory* memory)
+{
+	for (int x = 0; x < MEMORY_PAGE_COUNT; x++)
+	{
+		releasePage(memory->pages[x]);
+		memory->pages[x] = NULL;
+	}
+	memory->pageCount = 0;
+}
+
+// Writes the byte to the address, which the caller has checked is in memory. The first write to
+// a page allocates it, and the first write to a shared page copies it
+void writeMemoryByte(pagedMemory* memory, int address, int value)
+{
+	memoryPage** page = &memory->pages[address >> MEMORY_PAGE_SHIFT];
+
+	if (*page == NULL)
+	{
+		*page = allocatePage(memory, NULL);
+	}
+	else if (__atomic_load_n(&(*page)->references, __ATOMIC_ACQUIRE) > 1)
+	{
+		memoryPage* shared = *page;
+
+		*page = allocatePage(memory, shared);
+		releasePage(shared);
+	}
+	(*page)->bytes[address & (MEMORY_PAGE_SIZE - 1)] = value & 0xFF;
+}
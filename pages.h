@@ -0,0 +1,26 @@
+#pragma once
+
+#define MEMORY_PAGE_COUNT 256      // Pages in the 1 MB SIC/XE address space
+#define MEMORY_PAGE_SIZE 0x1000
+
+// Used to store one page of simulator memory. A page is shared by every memory cloned from the
+// same snapshot until one of them writes to it
+typedef struct memoryPage
+{
+	int references;
+	unsigned char bytes[MEMORY_PAGE_SIZE];
+} memoryPage;
+
+// Used to store the sparse memory of a simulator. A page is allocated when it is first written,
+// so a page that is never written reads as zeros and costs only its pointer
+typedef struct pagedMemory
+{
+	memoryPage* pages[MEMORY_PAGE_COUNT];
+	int pageCount;                 // Pages this memory allocated or copied
+} pagedMemory;
+
+void clonePagedMemory(pagedMemory* memory, pagedMemory* snapshot);
+int countMappedPages(pagedMemory* memory);
+int readMemoryByte(pagedMemory* memory, int address);
+void releasePagedMemory(pagedMemory* memory);
+void writeMemoryByte(pagedMemory* memory, int address, int value);
@@ -0,0 +1,504 @@
+#include "headers.h"
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define INITIAL_SOURCE_CAPACITY 64
+#define REGRESSION_MESSAGE_SIZE 160
+#define SLOWDOWN_LIST_SIZE 10
+#define SLOWDOWN_MINIMUM_MS 0.5       // Smaller changes are timer noise
+#define SLOWDOWN_MINIMUM_PERCENT 20.0
+
+// Outcomes of assembling one file of a regression run
+enum regressionStatus { REGRESSION_MATCHED, REGRESSION_MISMATCHED, REGRESSION_FAILED, REGRESSION_UNCHECKED };
+
+// Used to store one source file of a regression run and the outcome of assembling it
+typedef struct regressionFile
+{
+	char* filename;
+	int status;
+	int lineCount;           // Statements after macro expansion
+	double milliseconds;     // Time spent assembling, without the comparison
+	char message[REGRESSION_MESSAGE_SIZE];
+} regressionFile;
+
+// Used to hand out the source files of a regression run to the assembler threads
+typedef struct regressionQueue
+{
+	regressionFile* files;
+	int count;
+	int next;
+	pthread_mutex_t lock;
+	options* settings;
+	void (*assemble)(controlSection*, options*);
+} regressionQueue;
+
+// Used to store the time of one file in a timing file
+typedef struct fileTiming
+{
+	char* filename;
+	double milliseconds;
+} fileTiming;
+
+void addSourceFiles(char* path, bool named, char*** sources, int* count, int* capacity);
+void* assembleQueuedFiles(void* argument);
+void checkDisassemblyFile(regressionQueue* queue, regressionFile* file);
+void checkRegressionFile(regressionQueue* queue, regressionFile* file);
+int compareGoldenFile(char* text, size_t size, char* filename, char* directory, const char* extension, char* message);
+int compareSlowdowns(const void* first, const void* second);
+int compareSourcePaths(const void* first, const void* second);
+int compareTimings(const void* first, const void* second);
+char* createGoldenFilename(char* filename, char* directory, const char* extension);
+int readTimingFile(char* filename, fileTiming** timings);
+void reportTimingDeltas(regressionFile* files, int count, char* baselineFile);
+void writeTimingFile(regressionFile* files, int count, char* timingFile);
+
+// Adds the source file, or every .sic and .dis file below the directory, to the list of sources.
+// Files named on the command line are added whatever their extension
+void addSourceFiles(char* path, bool named, char*** sources, int* count, int* capacity)
+{
+	struct stat status;
+	struct dirent* entry;
+	char** entries = NULL;
+	int entryCount = 0;
+	DIR* directory;
+
+	if (stat(path, &status) == 0 && S_ISDIR(status.st_mode) && (directory = opendir(path)) != NULL)
+	{
+		// Entries are sorted so every run checks the files in the same order
+		while ((entry = readdir(directory)) != NULL)
+		{
+			if (entry->d_name[0] != '.')
+			{
+				entries = resizeMemory(entries, sizeof(char*) * (entryCount + 1));
+				entries[entryCount] = allocateMemory(strlen(path) + strlen(entry->d_name) + 2);
+				sprintf(entries[entryCount++], "%s/%s", path, entry->d_name);
+			}
+		}
+		closedir(directory);
+		qsort(entries, entryCount, sizeof(char*), compareSourcePaths);
+		for (int x = 0; x < entryCount; x++)
+		{
+			addSourceFiles(entries[x], false, sources, count, capacity);
+			releaseMemory(entries[x]);
+		}
+		releaseMemory(entries);
+		return;
+	}
+
+	char* extension = strrchr(path, '.');
+	if (named || (extension != NULL && (strcmp(extension, ".sic") == 0 || strcmp(extension, ".dis") == 0)))
+	{
+		if (*count == *capacity)
+		{
+			*capacity = *capacity > 0 ? *capacity * 2 : INITIAL_SOURCE_CAPACITY;
+			*sources = resizeMemory(*sources, sizeof(char*) * *capacity);
+		}
+		(*sources)[(*count)++] = duplicateString(path);
+	}
+}
+
+// Thread entry point; assembles and checks queued source files until none are left. A .dis file
+// is checked by disassembling instead
+void* assembleQueuedFiles(void* argument)
+{
+	regressionQueue* queue = (regressionQueue*)argument;
+	char* extension;
+	int next;
+
+	while (true)
+	{
+		pthread_mutex_lock(&queue->lock);
+		next = queue->next++;
+		pthread_mutex_unlock(&queue->lock);
+
+		if (next >= queue->count)
+		{
+			return NULL;
+		}
+		extension = strrchr(queue->files[next].filename, '.');
+		if (extension != NULL && strcmp(extension, ".dis") == 0)
+		{
+			checkDisassemblyFile(queue, &queue->files[next]);
+		}
+		else
+		{
+			checkRegressionFile(queue, &queue->files[next]);
+		}
+	}
+}
+
+// Disassembles the object file with the name of the .dis file and compares the listing text with
+// the golden .dis file
+void checkDisassemblyFile(regressionQueue* queue, regressionFile* file)
+{
+	char* objFilename = createFilename(file->filename, ".obj");
+	char* text;
+	size_t size = 0;
+	struct timespec start, end;
+	jmp_buf recovery;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	recoverFromErrors(&recovery, file->message, REGRESSION_MESSAGE_SIZE);
+	if (setjmp(recovery) != 0)
+	{
+		recoverFromErrors(NULL, NULL, 0);
+		file->message[strcspn(file->message, "\n")] = '\0';
+		file->status = REGRESSION_FAILED;
+		releaseMemory(objFilename);
+		return;
+	}
+	text = disassembleToText(objFilename, &size);
+	recoverFromErrors(NULL, NULL, 0);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	file->milliseconds = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+	if (text == NULL)
+	{
+		snprintf(file->message, REGRESSION_MESSAGE_SIZE, "%s cannot be disassembled", objFilename);
+		file->status = REGRESSION_FAILED;
+	}
+	else
+	{
+		for (size_t x = 0; x < size; x++)
+		{
+			file->lineCount += text[x] == '\n';
+		}
+		file->status = compareGoldenFile(text, size, file->filename, queue->settings->goldenDirectory, ".dis", file->message);
+	}
+
+	releaseMemory(text);
+	releaseMemory(objFilename);
+}
+
+// Assembles one source file in memory and compares its object code, then its listing, with the
+// golden files. An error in the source is recorded as the outcome of the file, and the cleanups
+// registered on the way release what the failed assembly held
+void checkRegressionFile(regressionQueue* queue, regressionFile* file)
+{
+	sourceLines source = { NULL, 0, 0 };
+	controlSection* sections = NULL;
+	int sectionCount = 0;
+	assemblyCleanup assembly = { &source, &sections, &sectionCount };
+	errorCleanup cleanup;
+	char* lstText = NULL;
+	char* objText = NULL;
+	size_t lstSize = 0, objSize = 0;
+	struct timespec start, end;
+	jmp_buf recovery;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	recoverFromErrors(&recovery, file->message, REGRESSION_MESSAGE_SIZE);
+	if (setjmp(recovery) != 0)
+	{
+		recoverFromErrors(NULL, NULL, 0);
+		file->message[strcspn(file->message, "\n")] = '\0';
+		file->status = REGRESSION_FAILED;
+		return;
+	}
+	pushErrorCleanup(&cleanup, releaseAssemblyCleanup, &assembly);
+	loadSourceFile(file->filename, &source);
+	sectionCount = splitControlSections(&source, &sections);
+	runControlSections(sections, sectionCount, queue->settings, queue->assemble);
+	joinControlSections(sections, sectionCount, &lstText, &lstSize, &objText, &objSize);
+	popErrorCleanup(&cleanup);
+	recoverFromErrors(NULL, NULL, 0);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	file->milliseconds = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+	file->lineCount = source.count;
+	file->status = compareGoldenFile(objText, objSize, file->filename, queue->settings->goldenDirectory, ".obj", file->message);
+	if (file->status == REGRESSION_MATCHED && !queue->settings->skipListing && !queue->settings->listingMap)
+	{
+		file->status = compareGoldenFile(lstText, lstSize, file->filename, queue->settings->goldenDirectory, ".lst", file->message);
+	}
+
+	releaseMemory(lstText);
+	releaseMemory(objText);
+	freeControlSections(sections, sectionCount);
+	freeSourceLines(&source);
+}
+
+// Compares the output text byte for byte with the golden file of the source file, reporting the
+// first line that differs
+// Returns the regression status of the output, with the reason in message if it did not match
+int compareGoldenFile(char* text, size_t size, char* filename, char* directory, const char* extension, char* message)
+{
+	char* goldenFilename = createGoldenFilename(filename, directory, extension);
+	FILE* file = fopen(goldenFilename, "rb");
+	struct stat status;
+	char* golden;
+	size_t goldenSize, offset = 0;
+	int line = 1;
+
+	if (file == NULL || fstat(fileno(file), &status) != 0)
+	{
+		snprintf(message, REGRESSION_MESSAGE_SIZE, "no golden file %s", goldenFilename);
+		if (file != NULL)
+		{
+			fclose(file);
+		}
+		releaseMemory(goldenFilename);
+		return REGRESSION_UNCHECKED;
+	}
+	goldenSize = status.st_size;
+	golden = allocateMemory(goldenSize + 1);
+	goldenSize = fread(golden, 1, goldenSize, file);
+	fclose(file);
+
+	if (goldenSize == size && memcmp(golden, text, size) == 0)
+	{
+		releaseMemory(golden);
+		releaseMemory(goldenFilename);
+		return REGRESSION_MATCHED;
+	}
+	while (offset < size && offset < goldenSize && text[offset] == golden[offset])
+	{
+		line += text[offset++] == '\n';
+	}
+	snprintf(message, REGRESSION_MESSAGE_SIZE, "%s differs from %s at line %d", extension + 1, goldenFilename, line);
+	releaseMemory(golden);
+	releaseMemory(goldenFilename);
+	return REGRESSION_MISMATCHED;
+}
+
+// Orders pairs of slowdown and file index from the largest to the smallest slowdown for qsort()
+int compareSlowdowns(const void* first, const void* second)
+{
+	const double* left = (const double*)first;
+	const double* right = (const double*)second;
+
+	return left[0] < right[0] ? 1 : left[0] > right[0] ? -1 : 0;
+}
+
+// Orders pointers to paths alphabetically for qsort()
+int compareSourcePaths(const void* first, const void* second)
+{
+	return strcmp(*(char* const*)first, *(char* const*)second);
+}
+
+// Orders file timings by filename for qsort() and bsearch()
+int compareTimings(const void* first, const void* second)
+{
+	return strcmp(((const fileTiming*)first)->filename, ((const fileTiming*)second)->filename);
+}
+
+// Returns the name of the golden output of the source file: the output filename in the golden
+// directory, keeping the relative path of the source, or next to the source without one
+char* createGoldenFilename(char* filename, char* directory, const char* extension)
+{
+	char* output = createFilename(filename, extension);
+	char* relative = output;
+	char* golden;
+
+	if (directory == NULL)
+	{
+		return output;
+	}
+	if (relative[0] == '/')
+	{
+		relative = strrchr(relative, '/') + 1;
+	}
+	while (strncmp(relative, "./", 2) == 0)
+	{
+		relative += 2;
+	}
+	golden = allocateMemory(strlen(directory) + strlen(relative) + 2);
+	sprintf(golden, "%s/%s", directory, relative);
+	releaseMemory(output);
+	return golden;
+}
+
+// Reads a timing file written by writeTimingFile() and sorts its timings by filename
+// Returns the number of timings; zero if the file cannot be read
+int readTimingFile(char* filename, fileTiming** timings)
+{
+	char path[PATH_MAX];
+	double milliseconds;
+	int count = 0, capacity = 0;
+	FILE* file = fopen(filename, "r");
+
+	*timings = NULL;
+	while (file != NULL && fscanf(file, "%lf %4095[^\n]", &milliseconds, path) == 2)
+	{
+		if (count == capacity)
+		{
+			capacity = capacity > 0 ? capacity * 2 : INITIAL_SOURCE_CAPACITY;
+			*timings = resizeMemory(*timings, sizeof(fileTiming) * capacity);
+		}
+		(*timings)[count].filename = duplicateString(path);
+		(*timings)[count++].milliseconds = milliseconds;
+	}
+	if (file != NULL)
+	{
+		fclose(file);
+	}
+	qsort(*timings, count, sizeof(fileTiming), compareTimings);
+	return count;
+}
+
+// Compares the time of each assembled file with the baseline timing file, printing the total
+// change and the files that slowed down the most
+void reportTimingDeltas(regressionFile* files, int count, char* baselineFile)
+{
+	fileTiming* baseline;
+	int baselineCount = readTimingFile(baselineFile, &baseline);
+	double (*slowdowns)[2] = allocateMemory(sizeof(*slowdowns) * (count + 1));
+	double before = 0.0, after = 0.0;
+	int slowdownCount = 0, common = 0;
+
+	if (baselineCount == 0)
+	{
+		printf("\nNo timings could be read from the baseline %s\n", baselineFile);
+		releaseMemory(slowdowns);
+		return;
+	}
+	for (int x = 0; x < count; x++)
+	{
+		fileTiming key = { files[x].filename, 0.0 };
+		fileTiming* timing = files[x].status != REGRESSION_FAILED ? bsearch(&key, baseline, baselineCount, sizeof(fileTiming), compareTimings) : NULL;
+		double delta;
+
+		if (timing == NULL)
+		{
+			continue;
+		}
+		common++;
+		before += timing->milliseconds;
+		after += files[x].milliseconds;
+		delta = files[x].milliseconds - timing->milliseconds;
+		if (delta >= SLOWDOWN_MINIMUM_MS && delta * 100.0 >= timing->milliseconds * SLOWDOWN_MINIMUM_PERCENT)
+		{
+			slowdowns[slowdownCount][0] = delta;
+			slowdowns[slowdownCount++][1] = x;
+		}
+	}
+	qsort(slowdowns, slowdownCount, sizeof(*slowdowns), compareSlowdowns);
+
+	printf("\nBaseline: %d files in both runs took %.1f ms, now %.1f ms (%+.1f%%)\n", common, before, after, before > 0 ? (after - before) * 100.0 / before : 0.0);
+	printf("%d files slowed down by at least %.0f%% and %.1f ms\n", slowdownCount, SLOWDOWN_MINIMUM_PERCENT, SLOWDOWN_MINIMUM_MS);
+	for (int x = 0; x < slowdownCount && x < SLOWDOWN_LIST_SIZE; x++)
+	{
+		regressionFile* file = &files[(int)slowdowns[x][1]];
+		printf("%10.3f ms  %+8.3f ms  %s\n", file->milliseconds, slowdowns[x][0], file->filename);
+	}
+
+	for (int x = 0; x < baselineCount; x++)
+	{
+		releaseMemory(baseline[x].filename);
+	}
+	releaseMemory(baseline);
+	releaseMemory(slowdowns);
+}
+
+// Assembles every source file in memory on a pool of threads and compares the object code and
+// listing of each with its golden files, then reports the files that did not match and the
+// throughput. Directories are searched for .sic files, and for .dis files whose object file is
+// disassembled instead. Nothing is written but the timing file
+// Returns the number of files that did not match their golden files
+int runRegression(char* filenames[], int count, options* settings, void (*assemble)(controlSection*, options*))
+{
+	options fileSettings = *settings;
+	regressionQueue queue = { NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER, &fileSettings, assemble };
+	const char* labels[] = { "MATCH", "MISMATCH", "ERROR", "NO GOLDEN" };
+	long threadCount = settings->jobs > 0 ? settings->jobs : sysconf(_SC_NPROCESSORS_ONLN);
+	char** sources = NULL;
+	int capacity = 0;
+	int outcomes[4] = { 0, 0, 0, 0 };
+	long lineCount = 0;
+	pthread_t* threads;
+	struct timespec start, end;
+
+	// Each file is assembled by one thread, so its control sections and listing are not threaded
+	fileSettings.jobs = 1;
+	for (int x = 0; x < count; x++)
+	{
+		addSourceFiles(filenames[x], true, &sources, &queue.count, &capacity);
+	}
+	queue.files = allocateZeroedMemory(queue.count + 1, sizeof(regressionFile));
+	for (int x = 0; x < queue.count; x++)
+	{
+		queue.files[x].filename = sources[x];
+	}
+	if (threadCount > queue.count)
+	{
+		threadCount = queue.count;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (threadCount <= 1)
+	{
+		assembleQueuedFiles(&queue);
+	}
+	else
+	{
+		threads = allocateMemory(sizeof(pthread_t) * threadCount);
+		for (int x = 0; x < threadCount; x++)
+		{
+			pthread_create(&threads[x], NULL, assembleQueuedFiles, &queue);
+		}
+		for (int x = 0; x < threadCount; x++)
+		{
+			pthread_join(threads[x], NULL);
+		}
+		releaseMemory(threads);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	for (int x = 0; x < queue.count; x++)
+	{
+		if (queue.files[x].status != REGRESSION_MATCHED)
+		{
+			printf("%-9s  %s: %s\n", labels[queue.files[x].status], queue.files[x].filename, queue.files[x].message);
+		}
+		outcomes[queue.files[x].status]++;
+		lineCount += queue.files[x].lineCount;
+	}
+
+	double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+	printf("\nRegression: %d files; %d matched, %d mismatched, %d failed to assemble, %d without golden files\n",
+		queue.count, outcomes[REGRESSION_MATCHED], outcomes[REGRESSION_MISMATCHED], outcomes[REGRESSION_FAILED], outcomes[REGRESSION_UNCHECKED]);
+	printf("Assembled %ld lines in %.3f s (%.0f files, %.0f lines per second) on %ld thread%s\n", lineCount, elapsed,
+		elapsed > 0 ? queue.count / elapsed : 0.0, elapsed > 0 ? lineCount / elapsed : 0.0, threadCount, threadCount == 1 ? "" : "s");
+
+	if (settings->baselineFile != NULL)
+	{
+		reportTimingDeltas(queue.files, queue.count, settings->baselineFile);
+	}
+	if (settings->timingFile != NULL)
+	{
+		writeTimingFile(queue.files, queue.count, settings->timingFile);
+	}
+
+	for (int x = 0; x < queue.count; x++)
+	{
+		releaseMemory(sources[x]);
+	}
+	releaseMemory(sources);
+	releaseMemory(queue.files);
+	return queue.count - outcomes[REGRESSION_MATCHED];
+}
+
+// Writes the assembly time of each file that assembled, one "milliseconds filename" per line,
+// for a later run to compare with
+void writeTimingFile(regressionFile* files, int count, char* timingFile)
+{
+	FILE* file = fopen(timingFile, "w");
+
+	if (file == NULL)
+	{
+		displayError(FILE_NOT_FOUND, timingFile);
+		return;
+	}
+	for (int x = 0; x < count; x++)
+	{
+		if (files[x].status != REGRESSION_FAILED)
+		{
+			fprintf(file, "%.3f %s\n", files[x].milliseconds, files[x].filename);
+		}
+	}
+	fclose(file);
+}
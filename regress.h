@@ -0,0 +1,3 @@
+#pragma once
+
+int runRegression(char* filenames[], int count, options* settings, void (*assemble)(controlSection*, options*));
@@ -0,0 +1,248 @@
+#include "headers.h"
+
+#define EXTENDED_CHARACTER '+'
+#define EXTERNAL -2
+#define FLAG_E 0x01
+#define FORMAT_3_MAX_VALUE 4095
+#define INITIAL_REFERENCE_CAPACITY 64
+#define UNRESOLVED -1
+
+int compareReferences(const void* first, const void* second);
+int computeShift(referenceTable* table, int* growth, int address);
+bool fitsFormat3(referenceTable* table, int* growth, reference* entry, int target, int base);
+void recordGrowth(int* growth, int count, int index);
+
+// Orders references by address for qsort()
+int compareReferences(const void* first, const void* second)
+{
+	return ((reference*)first)->address - ((reference*)second)->address;
+}
+
+// Returns the number of bytes added in front of the provided Pass 1 address by the
+// instructions extended so far, using a binary search and a Fenwick tree of extensions
+int computeShift(referenceTable* table, int* growth, int address)
+{
+	int low = 0, high = table->count;
+	int shift = 0;
+
+	// Count the references located before the address
+	while (low < high)
+	{
+		int mid = (low + high) / 2;
+		if (table->references[mid].address < address)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+
+	// Sum the extensions among those references
+	for (int x = low; x > 0; x -= x & -x)
+	{
+		shift += growth[x];
+	}
+	return shift;
+}
+
+// Marks the operation of the provided statement as Format 4 by prefixing a '+'
+void extendStatement(char* line)
+{
+	char operation[SEGMENT_SIZE] = { '\0' };
+	char field[SEGMENT_SIZE];
+	int x;
+
+	for (x = 0; x < SEGMENT_SIZE - 1 && !isspace(line[SEGMENT_SIZE - 1 + x]) && line[SEGMENT_SIZE - 1 + x] != '\0'; x++)
+	{
+		operation[x] = line[SEGMENT_SIZE - 1 + x];
+	}
+	snprintf(field, SEGMENT_SIZE, "%c%-*s", EXTENDED_CHARACTER, SEGMENT_SIZE - 2, operation);
+	memcpy(&line[SEGMENT_SIZE - 1], field, SEGMENT_SIZE - 1);
+}
+
+// Tests whether the reference can still be encoded as a Format 3 instruction once the
+// extensions recorded so far are applied, using the same ranges as Pass 2
+bool fitsFormat3(referenceTable* table, int* growth, reference* entry, int target, int base)
+{
+	int pcRelative;
+	int baseRelative;
+
+	if (entry->numeric)
+	{
+		return entry->value <= FORMAT_3_MAX_VALUE;
+	}
+	if (target == UNRESOLVED)
+	{
+		return true; // Pass 2 reports the unknown symbol
+	}
+	if (target == EXTERNAL)
+	{
+		return false; // The loader supplies the address in a Format 4 field
+	}
+
+	target += computeShift(table, growth, target);
+	pcRelative = target - (entry->address + computeShift(table, growth, entry->address) + 3);
+	if (pcRelative >= PC_MIN_RANGE && pcRelative <= PC_MAX_RANGE)
+	{
+		return true;
+	}
+	if (base != UNRESOLVED)
+	{
+		base += computeShift(table, growth, base);
+		baseRelative = target - base;
+		return baseRelative >= 0 && baseRelative <= BASE_MAX_RANGE;
+	}
+	return false;
+}
+
+// Releases the references collected during Pass 1
+void freeReferenceTable(referenceTable* table)
+{
+	releaseMemory(table->references);
+	memset(table, 0, sizeof(referenceTable));
+}
+
+// Records the operand of a BASE directive so later references know the base in effect
+void recordBaseDirective(referenceTable* table, char* operand)
+{
+	strncpy(table->base, operand, NAME_SIZE - 1);
+	table->base[NAME_SIZE - 1] = '\0';
+}
+
+// Adds a Fenwick tree entry for the extension of the reference with the provided index
+void recordGrowth(int* growth, int count, int index)
+{
+	for (int x = index + 1; x <= count; x += x & -x)
+	{
+		growth[x]++;
+	}
+}
+
+// Records an unextended Format 3 instruction whose operand can be relaxed to Format 4
+void recordReference(referenceTable* table, int line, int address, segment* segments)
+{
+	reference* entry;
+	char operand[OPERAND_SIZE];
+
+	if (segments->operation[0] == EXTENDED_CHARACTER || strlen(segments->operand) == 0)
+	{
+		return;
+	}
+
+	if (table->count == table->capacity)
+	{
+		table->capacity = table->capacity > 0 ? table->capacity * 2 : INITIAL_REFERENCE_CAPACITY;
+		table->references = resizeMemory(table->references, sizeof(reference) * table->capacity);
+	}
+	entry = &table->references[table->count++];
+	memset(entry, 0, sizeof(reference));
+	entry->line = line;
+	entry->address = address;
+	entry->block = table->block;
+	strcpy(entry->base, table->base);
+
+	getOperandSymbol(segments->operand, operand);
+	if (isdigit(operand[0]))
+	{
+		entry->numeric = true;
+		entry->value = strtol(operand, NULL, 10);
+	}
+	else
+	{
+		snprintf(entry->symbol, NAME_SIZE, "%.*s", NAME_SIZE - 1, operand);
+	}
+}
+
+// Chooses Format 3 or Format 4 for every recorded reference of the control section: each
+// instruction starts as Format 3 and is extended only when its operand cannot be reached,
+// repeating until no instruction grows. Extended statements are marked with '+' and the
+// symbol table and ending address are moved by the bytes added in front of them.
+// Returns the number of instructions extended
+int relaxFormats(controlSection* section)
+{
+	referenceTable* table = &section->references;
+	sourceLines* source = &section->source;
+	symbol** symbolTable = section->symbols;
+	address* addresses = &section->addresses;
+	int* targets = allocateMemory(sizeof(int) * (table->count + 1));
+	int* bases = allocateMemory(sizeof(int) * (table->count + 1));
+	int* growth = allocateZeroedMemory(table->count + 1, sizeof(int));
+	bool* extended = allocateZeroedMemory(table->count + 1, sizeof(bool));
+	int extendedCount = 0;
+	bool changed = true;
+	symbol* entry;
+
+	// Program blocks are placed out of source order, so the shift search needs the references sorted
+	if (section->blockCount > 1)
+	{
+		qsort(table->references, table->count, sizeof(reference), compareReferences);
+	}
+
+	// Resolve every operand and base symbol once against the Pass 1 addresses
+	for (int x = 0; x < table->count; x++)
+	{
+		entry = findSymbol(symbolTable, table->references[x].symbol);
+		targets[x] = entry != NULL ? entry->address : UNRESOLVED;
+		if (entry == NULL && isExternalReference(section, table->references[x].symbol))
+		{
+			targets[x] = EXTERNAL;
+		}
+		if (strlen(table->references[x].base) == 0)
+		{
+			bases[x] = addresses->base;
+		}
+		else
+		{
+			entry = findSymbol(symbolTable, table->references[x].base);
+			bases[x] = entry != NULL ? entry->address : UNRESOLVED;
+		}
+	}
+
+	// Extensions only ever add bytes, so the iteration stops once every reference fits
+	while (changed)
+	{
+		changed = false;
+		for (int x = 0; x < table->count; x++)
+		{
+			if (!extended[x] && !fitsFormat3(table, growth, &table->references[x], targets[x], bases[x]))
+			{
+				extended[x] = true;
+				recordGrowth(growth, table->count, x);
+				extendedCount++;
+				changed = true;
+			}
+		}
+	}
+
+	if (extendedCount > 0)
+	{
+		for (int x = 0; x < SYMBOL_TABLE_SIZE; x++)
+		{
+			if (symbolTable[x] != NULL)
+			{
+				symbolTable[x]->address += computeShift(table, growth, symbolTable[x]->address);
+			}
+		}
+		for (int x = 1; x < section->blockCount; x++)
+		{
+			section->blocks[x].start += computeShift(table, growth, section->blocks[x].start);
+		}
+		for (int x = 0; x < table->count; x++)
+		{
+			if (extended[x])
+			{
+				extendStatement(source->lines[table->references[x].line]);
+				section->names.operands[table->references[x].line].flags |= FLAG_E;
+			}
+		}
+		addresses->current += extendedCount;
+	}
+
+	releaseMemory(targets);
+	releaseMemory(bases);
+	releaseMemory(growth);
+	releaseMemory(extended);
+	return extendedCount;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+struct controlSection;
+
+// Used to store a Format 3 instruction whose format can be chosen automatically
+typedef struct reference
+{
+	int line;               // Index of the statement in the source lines
+	int address;            // Address of the instruction computed by Pass 1
+	int block;              // Program block of the instruction
+	int value;              // Numeric operand value
+	bool numeric;           // True when the operand is a number rather than a symbol
+	char symbol[NAME_SIZE]; // Operand symbol without addressing characters
+	char base[NAME_SIZE];   // Operand of the BASE directive in effect; empty if none
+} reference;
+
+// Used to collect the Format 3 references found during Pass 1
+typedef struct referenceTable
+{
+	reference* references;
+	int count;
+	int capacity;
+	char base[NAME_SIZE]; // Operand of the most recent BASE directive
+	int block;            // Program block selected by the most recent USE directive
+} referenceTable;
+
+void extendStatement(char* line);
+void freeReferenceTable(referenceTable* table);
+void recordBaseDirective(referenceTable* table, char* operand);
+void recordReference(referenceTable* table, int line, int address, segment* segments);
+int relaxFormats(struct controlSection* section);
@@ -0,0 +1,275 @@
+#include "headers.h"
+#include <pthread.h>
+#include <unistd.h>
+
+#define INITIAL_SECTION_CAPACITY 4
+#define NEW_LINE '\n'
+
+// Used to hand out control sections to the assembler threads
+typedef struct sectionQueue
+{
+	controlSection* sections;
+	int count;
+	int next;
+	pthread_mutex_t lock;
+	options* settings;
+	void (*assemble)(controlSection*, options*);
+} sectionQueue;
+
+void* assembleQueuedSections(void* argument);
+bool isCsectStatement(char* line);
+void writeSectionBuffer(FILE* file, char* buffer, size_t size, bool separate);
+
+// Adds the comma separated symbols of an EXTREF operand to the section
+void addExternalReferences(controlSection* section, char* operand)
+{
+	char name[OPERAND_SIZE];
+	int length = 0, id;
+
+	for (int x = 0; ; x++)
+	{
+		if (operand[x] == ',' || operand[x] == '\0')
+		{
+			name[length] = '\0';
+			if (length > 0 && !isExternalReference(section, name))
+			{
+				section->externalReferences = resizeMemory(section->externalReferences, sizeof(externalSymbol) * (section->externalReferenceCount + 1));
+				strcpy(section->externalReferences[section->externalReferenceCount].name, name);
+				section->externalReferences[section->externalReferenceCount].address = 0;
+				section->externalReferenceCount++;
+				id = internName(&section->names, name);
+				section->names.external[id] = true;
+			}
+			length = 0;
+			if (operand[x] == '\0')
+			{
+				return;
+			}
+		}
+		else if (length < NAME_SIZE - 1)
+		{
+			name[length++] = operand[x];
+		}
+	}
+}
+
+// Assembles control sections taken from the shared queue until none are left
+void* assembleQueuedSections(void* argument)
+{
+	sectionQueue* queue = (sectionQueue*)argument;
+	int next;
+
+	while (true)
+	{
+		pthread_mutex_lock(&queue->lock);
+		next = queue->next++;
+		pthread_mutex_unlock(&queue->lock);
+
+		if (next >= queue->count)
+		{
+			return NULL;
+		}
+		queue->assemble(&queue->sections[next], queue->settings);
+	}
+}
+
+// Releases the statements, symbols and output text of every control section, closing the output
+// streams an error left open
+void freeControlSections(controlSection* sections, int count)
+{
+	for (int x = 0; x < count; x++)
+	{
+		if (sections[x].fileLst != NULL)
+		{
+			fclose(sections[x].fileLst);
+			fclose(sections[x].fileObj);
+			fclose(sections[x].fileReport);
+		}
+		freeSourceLines(&sections[x].source);
+		freeSymbolTable(sections[x].symbols);
+		freeNamePool(&sections[x].names);
+		freeReferenceTable(&sections[x].references);
+		releaseMemory(sections[x].externalReferences);
+		releaseMemory(sections[x].blocks);
+		releaseMemory(sections[x].mapEntries);
+		releaseMemory(sections[x].lstBuffer);
+		releaseMemory(sections[x].objBuffer);
+		releaseMemory(sections[x].reportBuffer);
+	}
+	releaseMemory(sections);
+}
+
+// Tests whether the statement starts a new control section
+bool isCsectStatement(char* line)
+{
+	char operation[SEGMENT_SIZE];
+	int x;
+
+	if (line[0] == '#' || strlen(line) < SEGMENT_SIZE - 1)
+	{
+		return false;
+	}
+	for (x = 0; x < SEGMENT_SIZE - 1 && line[SEGMENT_SIZE - 1 + x] != '\0' && !isspace(line[SEGMENT_SIZE - 1 + x]); x++)
+	{
+		operation[x] = line[SEGMENT_SIZE - 1 + x];
+	}
+	operation[x] = '\0';
+	return isCsectDirective(isDirective(operation));
+}
+
+// Returns true if the symbol is listed by an EXTREF directive of the section; otherwise, false
+bool isExternalReference(controlSection* section, char* symbolName)
+{
+	for (int x = 0; x < section->externalReferenceCount; x++)
+	{
+		if (strcmp(section->externalReferences[x].name, symbolName) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// Joins the listing and object code text of each control section in source order into buffers
+// the caller releases with releaseMemory()
+void joinControlSections(controlSection* sections, int count, char** lstText, size_t* lstSize, char** objText, size_t* objSize)
+{
+	FILE* fileLst = openMemoryStream(lstText, lstSize);
+	FILE* fileObj = openMemoryStream(objText, objSize);
+
+	for (int x = 0; x < count; x++)
+	{
+		writeSectionBuffer(fileLst, sections[x].lstBuffer, sections[x].lstSize, x > 0 && sections[x - 1].lstSize > 0 && sections[x - 1].lstBuffer[sections[x - 1].lstSize - 1] != NEW_LINE);
+		writeSectionBuffer(fileObj, sections[x].objBuffer, sections[x].objSize, x > 0 && sections[x - 1].objSize > 0 && sections[x - 1].objBuffer[sections[x - 1].objSize - 1] != NEW_LINE);
+	}
+	fclose(fileLst);
+	fclose(fileObj);
+}
+
+// Releases the source lines and control sections of an assembly registered with
+// pushErrorCleanup()
+void releaseAssemblyCleanup(void* assembly)
+{
+	assemblyCleanup* held = assembly;
+
+	if (*held->sections != NULL)
+	{
+		freeControlSections(*held->sections, *held->sectionCount);
+	}
+	freeSourceLines(held->source);
+}
+
+// Assembles every control section with the provided function. Sections have their own symbol
+// table and location counter, so they are assembled concurrently, on as many threads as the
+// jobs setting allows, and their output is kept in memory until writeControlSections() emits
+// it in source order.
+void runControlSections(controlSection* sections, int count, options* settings, void (*assemble)(controlSection*, options*))
+{
+	sectionQueue queue = { sections, count, 0, PTHREAD_MUTEX_INITIALIZER, settings, assemble };
+	long threadCount = settings->jobs > 0 ? settings->jobs : sysconf(_SC_NPROCESSORS_ONLN);
+	pthread_t* threads;
+
+	for (int x = 0; x < count; x++)
+	{
+		sections[x].fileLst = openMemoryStream(&sections[x].lstBuffer, &sections[x].lstSize);
+		sections[x].fileObj = openMemoryStream(&sections[x].objBuffer, &sections[x].objSize);
+		sections[x].fileReport = openMemoryStream(&sections[x].reportBuffer, &sections[x].reportSize);
+	}
+
+	if (threadCount > count)
+	{
+		threadCount = count;
+	}
+	if (threadCount <= 1)
+	{
+		assembleQueuedSections(&queue);
+	}
+	else
+	{
+		threads = allocateMemory(sizeof(pthread_t) * threadCount);
+		for (int x = 0; x < threadCount; x++)
+		{
+			pthread_create(&threads[x], NULL, assembleQueuedSections, &queue);
+		}
+		for (int x = 0; x < threadCount; x++)
+		{
+			pthread_join(threads[x], NULL);
+		}
+		releaseMemory(threads);
+	}
+
+	for (int x = 0; x < count; x++)
+	{
+		fclose(sections[x].fileLst);
+		fclose(sections[x].fileObj);
+		fclose(sections[x].fileReport);
+		sections[x].fileLst = sections[x].fileObj = sections[x].fileReport = NULL;
+	}
+}
+
+// Separates the source lines into control sections, starting a new section at each CSECT
+// Returns the number of control sections
+int splitControlSections(sourceLines* source, controlSection** sections)
+{
+	int count = 0, capacity = INITIAL_SECTION_CAPACITY;
+	int first = 0;
+
+	*sections = allocateMemory(sizeof(controlSection) * capacity);
+	for (int x = 1; x <= source->count; x++)
+	{
+		if (x == source->count || isCsectStatement(source->lines[x]))
+		{
+			if (count == capacity)
+			{
+				capacity *= 2;
+				*sections = resizeMemory(*sections, sizeof(controlSection) * capacity);
+			}
+			memset(&(*sections)[count], 0, sizeof(controlSection));
+			(*sections)[count].number = count;
+			appendSourceLines(&(*sections)[count].source, source, first, x - first);
+			count++;
+			first = x;
+		}
+	}
+	if (count == 0)
+	{
+		memset(&(*sections)[count], 0, sizeof(controlSection));
+		count++;
+	}
+
+	for (int x = 0; x < count; x++)
+	{
+		(*sections)[x].relocatable = count > 1;
+	}
+	return count;
+}
+
+// Writes the listing and object code text of each control section in source order
+void writeControlSections(controlSection* sections, int count, char* lstFilename, char* objFilename)
+{
+	char* lstText = NULL;
+	char* objText = NULL;
+	size_t lstSize = 0, objSize = 0;
+
+	joinControlSections(sections, count, &lstText, &lstSize, &objText, &objSize);
+
+	// Files whose text is unchanged keep their modification time
+	if (lstFilename != NULL)
+	{
+		writeFileIfChanged(lstFilename, lstText, lstSize);
+	}
+	writeFileIfChanged(objFilename, objText, objSize);
+	releaseMemory(lstText);
+	releaseMemory(objText);
+}
+
+// Writes the text of one control section, starting it on a new line when the previous
+// section did not end with one
+void writeSectionBuffer(FILE* file, char* buffer, size_t size, bool separate)
+{
+	if (separate)
+	{
+		fputc(NEW_LINE, file);
+	}
+	fwrite(buffer, 1, size, file);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+// Used to store the state of one control section while it is assembled
+typedef struct controlSection
+{
+	int number;                         // Position of the section in the source file
+	char name[NAME_SIZE];               // Label of the START or CSECT statement
+	bool relocatable;                   // True when the program has more than one section
+	sourceLines source;                 // Statements belonging to the section
+	symbol* symbols[SYMBOL_TABLE_SIZE];
+	namePool names;                     // Interned symbol names and the operand of each statement
+	address addresses;
+	referenceTable references;          // Format 3 references recorded by Pass 1
+	externalSymbol* externalReferences; // Symbols listed by EXTREF
+	int externalReferenceCount;
+	int extendedCount;                  // Instructions extended by format selection
+	programBlock* blocks;               // Program blocks selected by USE, in order of first use
+	int blockCount;
+	int blockCapacity;
+	FILE* fileLst;                      // Listing text of the section
+	char* lstBuffer;
+	size_t lstSize;
+	FILE* fileObj;                      // Object code text of the section
+	char* objBuffer;
+	size_t objSize;
+	FILE* fileReport;                   // Analysis output displayed with the symbol table
+	char* reportBuffer;
+	size_t reportSize;
+	listingMapEntry* mapEntries;        // Listed statements when the listing is deferred to a map
+	int mapCount;
+	int mapCapacity;
+} controlSection;
+
+// Used to release the source lines and control sections of one assembly if an error recovers
+// past the function that holds them. The fields point to that function's variables, so the
+// sections are found once splitControlSections() has filled them in
+typedef struct assemblyCleanup
+{
+	sourceLines* source;
+	controlSection** sections; // NULL until the source is split
+	int* sectionCount;
+} assemblyCleanup;
+
+void addExternalReferences(controlSection* section, char* operand);
+void freeControlSections(controlSection* sections, int count);
+bool isExternalReference(controlSection* section, char* symbolName);
+void joinControlSections(controlSection* sections, int count, char** lstText, size_t* lstSize, char** objText, size_t* objSize);
+void releaseAssemblyCleanup(void* assembly);
+void runControlSections(controlSection* sections, int count, options* settings, void (*assemble)(controlSection*, options*));
+int splitControlSections(sourceLines* source, controlSection** sections);
+void writeControlSections(controlSection* sections, int count, char* lstFilename, char* objFilename);
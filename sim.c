@@ -0,0 +1,1047 @@
+#include "headers.h"
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BATCH_OUTPUT_SIZE 160
+#define CONDITION_EQUAL 0x40
+#define CONDITION_GREATER 0x80
+#define DISPLACEMENT_SIGN 0x800
+#define HALT_ADDRESS 0xFFFFFF
+#define HOT_LIST_SIZE 10
+#define PROFILE_LINE_SIZE 128
+#define REGISTER_A 0
+#define REGISTER_B 3
+#define REGISTER_L 2
+#define REGISTER_PC 8
+#define REGISTER_S 4
+#define REGISTER_SW 9
+#define REGISTER_T 5
+#define REGISTER_X 1
+#define WORD_MASK 0xFFFFFF
+#define WORD_SIGN 0x800000
+
+// Every opcode value by name, built from the opcode list
+#define OPCODE_VALUE(name, format, value) OP_##name = value,
+enum opcodeValues { OPCODE_LIST(OPCODE_VALUE) };
+
+// Used to store one line of the listing with the address it was loaded at
+typedef struct profileLine
+{
+	int address;             // Loaded address; -1 if the line has no address
+	bool instruction;        // True when the line holds an instruction
+	char label[SEGMENT_SIZE];
+	char text[PROFILE_LINE_SIZE];
+} profileLine;
+
+// Used to total the executions of the instructions that follow a label
+typedef struct profileLabel
+{
+	char label[SEGMENT_SIZE];
+	int address;
+	unsigned long count;
+} profileLabel;
+
+// Used to store a loop found from a taken jump back to an earlier address
+typedef struct profileLoop
+{
+	int first;
+	int last;
+	unsigned long iterations;
+	unsigned long instructions;
+	char label[SEGMENT_SIZE];
+} profileLoop;
+
+// Used to store an object file of a batch loaded into memory. Every run of the file clones
+// the memory, so the image is loaded once however many times the file is run
+typedef struct batchImage
+{
+	char* filename;
+	char* devicePrefix;      // "name." for the input devices of name.obj
+	pagedMemory memory;
+	int entry;               // Address execution starts at; -1 if the file could not be loaded
+} batchImage;
+
+// Used to store the result of one run of a batch
+typedef struct batchRun
+{
+	batchImage* image;
+	long steps;
+	int pages;               // Pages the run could read, shared with its image or not
+	int copiedPages;         // Pages the run allocated or copied from its image
+	bool completed;
+	char stopReason[80];
+	char output[BATCH_OUTPUT_SIZE]; // Size and hash of each output device
+} batchRun;
+
+// Used to hand out the images to load, then the runs, to the simulator threads
+typedef struct batchQueue
+{
+	batchImage* images;
+	batchRun* runs;
+	int count;
+	int next;
+	pthread_mutex_t lock;
+	long maxSteps;
+	void (*task)(struct batchQueue*, int);
+} batchQueue;
+
+void closeDevices(simulator* sim, char* output);
+int compareFilenames(const void* first, const void* second);
+int compareProfileLabels(const void* first, const void* second);
+int compareProfileLines(const void* first, const void* second);
+int compareProfileLoops(const void* first, const void* second);
+int compareWords(int left, int right);
+bool executeInstruction(simulator* sim);
+void executeFormat2(simulator* sim, const opcode* op, unsigned char* bytes, int* next);
+void executeFormat3(simulator* sim, const opcode* op, int address, bool immediate, int* next);
+FILE* getDevice(simulator* sim, int device, bool output);
+void loadBatchImage(batchQueue* queue, int index);
+int loadPrograms(pagedMemory* memory, objectProgram* programs, int count);
+int readListing(char* filename, objectProgram* programs, int count, profileLine** lines);
+int readWord(pagedMemory* memory, int address);
+void reportProfile(simulator* sim, profileLine* lines, int lineCount, char* profFilename);
+void runBatchProgram(batchQueue* queue, int index);
+void runBatchTasks(batchQueue* queue, int count, void (*task)(batchQueue*, int), long threadCount);
+void* runQueuedBatchTasks(void* argument);
+int signExtend(int value);
+void stopSimulation(simulator* sim, const char* reason, int address);
+bool writeWord(pagedMemory* memory, int address, int value);
+
+// Closes the devices of the simulator, summarizing each captured output device by its size
+// and 32-bit FNV-1a hash, then releases the captured output
+void closeDevices(simulator* sim, char* output)
+{
+	int length = 0;
+
+	if (output != NULL)
+	{
+		output[0] = '\0';
+	}
+	for (int x = 0; x < SIMULATOR_DEVICE_COUNT; x++)
+	{
+		if (sim->devices[x] == NULL)
+		{
+			continue;
+		}
+		fclose(sim->devices[x]);
+		if (sim->outputs[x] != NULL)
+		{
+			uint32_t hash = hashBytes(FNV32_OFFSET_BASIS, sim->outputs[x], sim->outputSizes[x]);
+
+			if (output != NULL && length < BATCH_OUTPUT_SIZE)
+			{
+				length += snprintf(output + length, BATCH_OUTPUT_SIZE - length, "; device %02X wrote %zu bytes (%08X)", x, sim->outputSizes[x], hash);
+			}
+			releaseMemory(sim->outputs[x]);
+		}
+	}
+}
+
+// Orders pointers to the filenames of the command line alphabetically for qsort(), keeping
+// repeated names in command line order
+int compareFilenames(const void* first, const void* second)
+{
+	char** left = *(char** const*)first;
+	char** right = *(char** const*)second;
+	int order = strcmp(*left, *right);
+
+	return order != 0 ? order : (left > right) - (left < right);
+}
+
+// Orders labels from the most to the least executed for qsort()
+int compareProfileLabels(const void* first, const void* second)
+{
+	unsigned long left = ((const profileLabel*)first)->count;
+	unsigned long right = ((const profileLabel*)second)->count;
+
+	return left < right ? 1 : left > right ? -1 : 0;
+}
+
+// Orders pairs of execution count and line number from the most to the least executed for
+// qsort(), keeping equal counts in listing order
+int compareProfileLines(const void* first, const void* second)
+{
+	const unsigned long* left = (const unsigned long*)first;
+	const unsigned long* right = (const unsigned long*)second;
+
+	return left[0] < right[0] ? 1 : left[0] > right[0] ? -1 : (left[1] > right[1]) - (left[1] < right[1]);
+}
+
+// Orders loops from the most to the least instructions executed for qsort()
+int compareProfileLoops(const void* first, const void* second)
+{
+	unsigned long left = ((const profileLoop*)first)->instructions;
+	unsigned long right = ((const profileLoop*)second)->instructions;
+
+	return left < right ? 1 : left > right ? -1 : 0;
+}
+
+// Compares two 24-bit words as signed values
+// Returns -1, 0 or 1 for the condition code
+int compareWords(int left, int right)
+{
+	left = signExtend(left);
+	right = signExtend(right);
+	return left < right ? -1 : left > right;
+}
+
+// Executes the instruction at the program counter and counts it in the profile
+// Returns true if the simulation continues; otherwise, false
+bool executeInstruction(simulator* sim)
+{
+	int pc = sim->registers[REGISTER_PC];
+	unsigned char bytes[4];
+	const opcode* op;
+	int next, length;
+
+	if (pc < 0 || pc + 4 > SIMULATOR_MEMORY_SIZE)
+	{
+		stopSimulation(sim, "address out of memory at", pc);
+		return false;
+	}
+	if (sim->steps == sim->maxSteps)
+	{
+		stopSimulation(sim, "step limit reached at", pc);
+		return false;
+	}
+
+	for (int x = 0; x < 4; x++)
+	{
+		bytes[x] = readMemoryByte(&sim->memory, pc + x);
+	}
+	if ((op = decodeOpcode(bytes[0])) == NULL)
+	{
+		stopSimulation(sim, "illegal instruction at", pc);
+		return false;
+	}
+	if (sim->counts != NULL)
+	{
+		sim->counts[pc]++;
+	}
+	sim->steps++;
+
+	if (op->format == 1)
+	{
+		stopSimulation(sim, "unsupported instruction at", pc);
+		return false;
+	}
+	else if (op->format == 2)
+	{
+		length = 2;
+		next = pc + length;
+		executeFormat2(sim, op, bytes, &next);
+	}
+	else
+	{
+		int ni = bytes[0] & 0x03;
+		int address;
+
+		if (ni == 0)
+		{
+			// SIC instructions have a 15-bit address and no n, i, b, p or e bits
+			length = 3;
+			address = ((bytes[1] & 0x7F) << 8) | bytes[2];
+		}
+		else if (bytes[1] & 0x10)
+		{
+			length = 4;
+			address = ((bytes[1] & 0x0F) << 16) | (bytes[2] << 8) | bytes[3];
+		}
+		else
+		{
+			length = 3;
+			address = ((bytes[1] & 0x0F) << 8) | bytes[2];
+			if (bytes[1] & 0x20)
+			{
+				address = pc + length + (address & DISPLACEMENT_SIGN ? address - (DISPLACEMENT_SIGN << 1) : address);
+			}
+			else if (bytes[1] & 0x40)
+			{
+				address += sim->registers[REGISTER_B];
+			}
+		}
+		if (bytes[1] & 0x80)
+		{
+			address += sim->registers[REGISTER_X];
+		}
+		address &= WORD_MASK;
+		if (ni == 2)
+		{
+			address = readWord(&sim->memory, address);
+		}
+		next = pc + length;
+		executeFormat3(sim, op, address, ni == 1, &next);
+	}
+
+	if (sim->stopReason[0] != '\0')
+	{
+		return false;
+	}
+	if (next != pc + length)
+	{
+		if (sim->taken != NULL)
+		{
+			sim->taken[pc]++;
+			sim->targets[pc] = next;
+		}
+		if (next == pc)
+		{
+			stopSimulation(sim, "halted by a jump to itself at", pc);
+			sim->completed = true;
+			return false;
+		}
+		if (next == HALT_ADDRESS)
+		{
+			stopSimulation(sim, "returned from the program at", pc);
+			sim->completed = true;
+			return false;
+		}
+	}
+	sim->registers[REGISTER_PC] = next;
+	return true;
+}
+
+// Executes a Format 2 instruction on its two register fields
+void executeFormat2(simulator* sim, const opcode* op, unsigned char* bytes, int* next)
+{
+	int first = bytes[1] >> 4;
+	int second = bytes[1] & 0x0F;
+	int* registers = sim->registers;
+	int shift = second + 1;
+
+	if (first > REGISTER_SW || second > REGISTER_SW)
+	{
+		stopSimulation(sim, "illegal register at", *next - 2);
+		return;
+	}
+	switch (op->value)
+	{
+		case OP_ADDR:
+			registers[second] = (registers[second] + registers[first]) & WORD_MASK;
+			break;
+		case OP_CLEAR:
+			registers[first] = 0;
+			break;
+		case OP_COMPR:
+			sim->conditionCode = compareWords(registers[first], registers[second]);
+			break;
+		case OP_DIVR:
+			if (registers[first] == 0)
+			{
+				stopSimulation(sim, "division by zero at", *next - 2);
+				return;
+			}
+			registers[second] = (signExtend(registers[second]) / signExtend(registers[first])) & WORD_MASK;
+			break;
+		case OP_MULR:
+			registers[second] = (signExtend(registers[second]) * signExtend(registers[first])) & WORD_MASK;
+			break;
+		case OP_RMO:
+			registers[second] = registers[first];
+			break;
+		case OP_SHIFTL:
+			registers[first] = ((registers[first] << (shift % 24)) | (registers[first] >> (24 - shift % 24))) & WORD_MASK;
+			break;
+		case OP_SHIFTR:
+			registers[first] = (signExtend(registers[first]) >> (shift > 23 ? 23 : shift)) & WORD_MASK;
+			break;
+		case OP_SUBR:
+			registers[second] = (registers[second] - registers[first]) & WORD_MASK;
+			break;
+		case OP_TIXR:
+			registers[REGISTER_X] = (registers[REGISTER_X] + 1) & WORD_MASK;
+			sim->conditionCode = compareWords(registers[REGISTER_X], registers[first]);
+			break;
+		default:
+			stopSimulation(sim, "supervisor call at", *next - 2);
+			sim->completed = true;
+			break;
+	}
+}
+
+// Executes a Format 3 or Format 4 instruction on its target address. Immediate operands use
+// the address as the value
+void executeFormat3(simulator* sim, const opcode* op, int address, bool immediate, int* next)
+{
+	int* registers = sim->registers;
+	int pc = registers[REGISTER_PC];
+	int value = 0;
+	FILE* device;
+
+	// Jumps, stores and the byte instructions use the address; everything else reads a word
+	switch (op->value)
+	{
+		case OP_J: case OP_JEQ: case OP_JGT: case OP_JLT: case OP_JSUB: case OP_RSUB:
+		case OP_STA: case OP_STB: case OP_STCH: case OP_STL: case OP_STS: case OP_STSW: case OP_STT: case OP_STX:
+			break;
+		case OP_LDCH: case OP_RD: case OP_TD: case OP_WD:
+			value = immediate ? address & 0xFF : address < SIMULATOR_MEMORY_SIZE ? readMemoryByte(&sim->memory, address) : -1;
+			break;
+		default:
+			value = immediate ? address : readWord(&sim->memory, address);
+			break;
+	}
+	if (value < 0)
+	{
+		stopSimulation(sim, "address out of memory at", pc);
+		return;
+	}
+
+	switch (op->value)
+	{
+		case OP_ADD:
+			registers[REGISTER_A] = (registers[REGISTER_A] + value) & WORD_MASK;
+			break;
+		case OP_AND:
+			registers[REGISTER_A] &= value;
+			break;
+		case OP_COMP:
+			sim->conditionCode = compareWords(registers[REGISTER_A], value);
+			break;
+		case OP_DIV:
+			if (value == 0)
+			{
+				stopSimulation(sim, "division by zero at", pc);
+				return;
+			}
+			registers[REGISTER_A] = (signExtend(registers[REGISTER_A]) / signExtend(value)) & WORD_MASK;
+			break;
+		case OP_J:
+			*next = address;
+			break;
+		case OP_JEQ:
+			*next = sim->conditionCode == 0 ? address : *next;
+			break;
+		case OP_JGT:
+			*next = sim->conditionCode > 0 ? address : *next;
+			break;
+		case OP_JLT:
+			*next = sim->conditionCode < 0 ? address : *next;
+			break;
+		case OP_JSUB:
+			registers[REGISTER_L] = *next;
+			*next = address;
+			break;
+		case OP_LDA: registers[REGISTER_A] = value; break;
+		case OP_LDB: registers[REGISTER_B] = value; break;
+		case OP_LDL: registers[REGISTER_L] = value; break;
+		case OP_LDS: registers[REGISTER_S] = value; break;
+		case OP_LDT: registers[REGISTER_T] = value; break;
+		case OP_LDX: registers[REGISTER_X] = value; break;
+		case OP_LDCH:
+			registers[REGISTER_A] = (registers[REGISTER_A] & 0xFFFF00) | value;
+			break;
+		case OP_MUL:
+			registers[REGISTER_A] = (signExtend(registers[REGISTER_A]) * signExtend(value)) & WORD_MASK;
+			break;
+		case OP_OR:
+			registers[REGISTER_A] |= value;
+			break;
+		case OP_RD:
+			device = getDevice(sim, value, false);
+			registers[REGISTER_A] = (registers[REGISTER_A] & 0xFFFF00) | (device != NULL && (value = fgetc(device)) != EOF ? value : 0);
+			break;
+		case OP_RSUB:
+			*next = registers[REGISTER_L];
+			break;
+		case OP_STA: case OP_STB: case OP_STL: case OP_STS: case OP_STT: case OP_STX:
+		{
+			int source = op->value == OP_STA ? REGISTER_A : op->value == OP_STB ? REGISTER_B : op->value == OP_STL ? REGISTER_L :
+				op->value == OP_STS ? REGISTER_S : op->value == OP_STT ? REGISTER_T : REGISTER_X;
+			if (!writeWord(&sim->memory, address, registers[source]))
+			{
+				stopSimulation(sim, "address out of memory at", pc);
+			}
+			break;
+		}
+		case OP_STCH:
+			if (address >= SIMULATOR_MEMORY_SIZE)
+			{
+				stopSimulation(sim, "address out of memory at", pc);
+				return;
+			}
+			writeMemoryByte(&sim->memory, address, registers[REGISTER_A]);
+			break;
+		case OP_STSW:
+			registers[REGISTER_SW] = sim->conditionCode == 0 ? CONDITION_EQUAL : sim->conditionCode > 0 ? CONDITION_GREATER : 0;
+			if (!writeWord(&sim->memory, address, registers[REGISTER_SW]))
+			{
+				stopSimulation(sim, "address out of memory at", pc);
+			}
+			break;
+		case OP_SUB:
+			registers[REGISTER_A] = (registers[REGISTER_A] - value) & WORD_MASK;
+			break;
+		case OP_TD:
+			// Every device is always ready
+			sim->conditionCode = -1;
+			break;
+		case OP_TIX:
+			registers[REGISTER_X] = (registers[REGISTER_X] + 1) & WORD_MASK;
+			sim->conditionCode = compareWords(registers[REGISTER_X], value);
+			break;
+		case OP_WD:
+			if ((device = getDevice(sim, value, true)) != NULL)
+			{
+				fputc(registers[REGISTER_A] & 0xFF, device);
+			}
+			break;
+		default:
+			stopSimulation(sim, "unsupported instruction at", pc);
+			break;
+	}
+}
+
+// Returns the file of a device, opening XX.dev after the device prefix for the device number
+// XX the first time it is used, or a memory buffer for a captured output device; NULL if an
+// input device has no file
+FILE* getDevice(simulator* sim, int device, bool output)
+{
+	char filename[PATH_MAX];
+
+	if (sim->devices[device] == NULL && output && sim->captureOutput)
+	{
+		sim->devices[device] = openMemoryStream(&sim->outputs[device], &sim->outputSizes[device]);
+	}
+	else if (sim->devices[device] == NULL)
+	{
+		snprintf(filename, sizeof(filename), "%s%02X.dev", sim->devicePrefix != NULL ? sim->devicePrefix : "", device);
+		sim->devices[device] = fopen(filename, output ? "wb" : "rb");
+	}
+	return sim->devices[device];
+}
+
+// Loads the object file of a batch image into the memory its runs are cloned from
+void loadBatchImage(batchQueue* queue, int index)
+{
+	batchImage* image = &queue->images[index];
+	objectProgram* programs;
+	int programCount = loadObjectFile(image->filename, &programs);
+
+	image->devicePrefix = createFilename(image->filename, ".");
+	image->entry = -1;
+	if (programCount <= 0)
+	{
+		return;
+	}
+	if ((image->entry = loadPrograms(&image->memory, programs, programCount)) < 0)
+	{
+		displayError(OUT_OF_MEMORY, image->filename);
+	}
+	freeObjectPrograms(programs, programCount);
+}
+
+// Loads the control sections one after another from the start address of the first,
+// adding each section's load address to the fields named by its M records. Only the bytes
+// of T records are written, so reserved storage allocates no pages
+// Returns the address execution starts at; -1 if the programs do not fit in memory
+int loadPrograms(pagedMemory* memory, objectProgram* programs, int count)
+{
+	int* deltas = allocateMemory(sizeof(int) * count);
+	int next = programs[0].start;
+	int entry;
+
+	for (int x = 0; x < count; x++)
+	{
+		if (next < 0 || next + programs[x].length > SIMULATOR_MEMORY_SIZE)
+		{
+			releaseMemory(deltas);
+			return -1;
+		}
+		deltas[x] = next - programs[x].start;
+		for (int y = 0; y < programs[x].length; y++)
+		{
+			if (programs[x].present[y])
+			{
+				writeMemoryByte(memory, next + y, programs[x].bytes[y]);
+			}
+		}
+		next += programs[x].length;
+	}
+
+	for (int x = 0; x < count; x++)
+	{
+		for (int y = 0; y < programs[x].modificationCount; y++)
+		{
+			modificationRecord* record = &programs[x].modifications[y];
+			int field = record->address + deltas[x];
+			int mask = record->length >= 6 ? WORD_MASK : (1 << (record->length * 4)) - 1;
+			int amount = 0;
+
+			// A section name adds its load offset; an external symbol adds its loaded address
+			for (int z = 0; z < count; z++)
+			{
+				if (strcmp(programs[z].name, record->symbol) == 0)
+				{
+					amount = deltas[z];
+				}
+				for (int w = 0; w < programs[z].definitionCount; w++)
+				{
+					if (strcmp(programs[z].definitions[w].name, record->symbol) == 0)
+					{
+						amount = programs[z].definitions[w].address + deltas[z];
+					}
+				}
+			}
+			if (field >= 0 && field + 3 <= SIMULATOR_MEMORY_SIZE)
+			{
+				int value = readWord(memory, field);
+				writeWord(memory, field, (value & ~mask) | ((value + amount) & mask));
+			}
+		}
+	}
+
+	entry = (programs[0].entry >= 0 ? programs[0].entry : programs[0].start) + deltas[0];
+	releaseMemory(deltas);
+	return entry;
+}
+
+// Simulates each object file, counting the executions of every instruction and the jumps
+// taken, then joins the counts with the listing written next to the object file
+// Returns the number of files that could not be simulated
+int profileFiles(char* filenames[], int count, long maxSteps)
+{
+	int failures = 0;
+
+	for (int x = 0; x < count; x++)
+	{
+		objectProgram* programs;
+		int programCount = loadObjectFile(filenames[x], &programs);
+		char* lstFilename = createFilename(filenames[x], ".lst");
+		char* profFilename = createFilename(filenames[x], ".prof");
+		simulator sim;
+		profileLine* lines = NULL;
+		int lineCount = 0;
+		int entry;
+
+		if (programCount <= 0)
+		{
+			failures++;
+			releaseMemory(lstFilename);
+			releaseMemory(profFilename);
+			continue;
+		}
+		memset(&sim, 0, sizeof(simulator));
+		sim.counts = allocateZeroedMemory(SIMULATOR_MEMORY_SIZE, sizeof(uint32_t));
+		sim.taken = allocateZeroedMemory(SIMULATOR_MEMORY_SIZE, sizeof(uint32_t));
+		sim.targets = allocateZeroedMemory(SIMULATOR_MEMORY_SIZE, sizeof(int));
+		sim.maxSteps = maxSteps;
+
+		if ((entry = loadPrograms(&sim.memory, programs, programCount)) < 0)
+		{
+			displayError(OUT_OF_MEMORY, filenames[x]);
+			failures++;
+		}
+		else
+		{
+			// The program returns to the simulator through the L register it starts with
+			sim.registers[REGISTER_PC] = entry;
+			sim.registers[REGISTER_L] = HALT_ADDRESS;
+			while (executeInstruction(&sim))
+			{
+			}
+
+			lineCount = readListing(lstFilename, programs, programCount, &lines);
+			if (count > 1)
+			{
+				printf("%s%s:\n", x > 0 ? "\n" : "", filenames[x]);
+			}
+			printf("Simulation: %ld instructions executed; %s\n", sim.steps, sim.stopReason);
+			reportProfile(&sim, lines, lineCount, lineCount > 0 ? profFilename : NULL);
+			if (lineCount == 0)
+			{
+				printf("No listing found (%s); the profile shows addresses only\n", lstFilename);
+			}
+		}
+
+		closeDevices(&sim, NULL);
+		releaseMemory(lines);
+		releasePagedMemory(&sim.memory);
+		releaseMemory(sim.counts);
+		releaseMemory(sim.taken);
+		releaseMemory(sim.targets);
+		releaseMemory(lstFilename);
+		releaseMemory(profFilename);
+		freeObjectPrograms(programs, programCount);
+	}
+	return failures;
+}
+
+// Reads the listing of the object file and computes the loaded address of each line, counting
+// control sections by their CSECT statements
+// Returns the number of lines; zero if there is no listing
+int readListing(char* filename, objectProgram* programs, int count, profileLine** lines)
+{
+	char text[PROFILE_LINE_SIZE];
+	char operation[SEGMENT_SIZE];
+	int lineCount = 0, capacity = 0;
+	int section = 0, load = programs[0].start;
+	bool crossReference = false;
+	FILE* file = fopen(filename, "r");
+
+	*lines = NULL;
+	while (file != NULL && fgets(text, PROFILE_LINE_SIZE, file))
+	{
+		profileLine* line;
+		char* end;
+		int address;
+
+		text[strcspn(text, "\r\n")] = '\0';
+		if (strlen(text) == 0)
+		{
+			continue;
+		}
+		if (lineCount == capacity)
+		{
+			capacity = capacity > 0 ? capacity * 2 : 256;
+			*lines = resizeMemory(*lines, sizeof(profileLine) * capacity);
+		}
+		line = &(*lines)[lineCount++];
+		memset(line, 0, sizeof(profileLine));
+		snprintf(line->text, PROFILE_LINE_SIZE, "%s", text);
+
+		// Columns as written by writeToLstFile(): address, label, operation and operand
+		address = strtol(text, &end, 16);
+		sscanf(text + SEGMENT_SIZE - 1, "%8s", line->label);
+		if (isspace((unsigned char)text[SEGMENT_SIZE - 1]))
+		{
+			line->label[0] = '\0';
+		}
+		operation[0] = '\0';
+		if (strlen(text) > (SEGMENT_SIZE - 1) * 2)
+		{
+			sscanf(text + (SEGMENT_SIZE - 1) * 2, "%8s", operation);
+		}
+		if (strcmp(operation, "CSECT") == 0 && section + 1 < count)
+		{
+			load += programs[section].length;
+			section++;
+		}
+
+		// The cross-reference written with -r runs from its heading to the next section
+		crossReference = (crossReference || strcmp(text, "CROSS REFERENCE") == 0) && strcmp(operation, "CSECT") != 0;
+		if (crossReference)
+		{
+			line->address = -1;
+			line->label[0] = '\0';
+			continue;
+		}
+		line->address = end != text ? address - programs[section].start + load : -1;
+		line->instruction = isOpcode(operation[0] == '+' ? operation + 1 : operation);
+	}
+	if (file != NULL)
+	{
+		fclose(file);
+	}
+	return lineCount;
+}
+
+// Reads the 24-bit word at the address
+// Returns the word; -1 if the address is outside memory
+int readWord(pagedMemory* memory, int address)
+{
+	if (address < 0 || address + 3 > SIMULATOR_MEMORY_SIZE)
+	{
+		return -1;
+	}
+	return (readMemoryByte(memory, address) << 16) | (readMemoryByte(memory, address + 1) << 8) | readMemoryByte(memory, address + 2);
+}
+
+// Prints the hottest lines, labels and loops, and writes the listing annotated with the
+// execution count of each instruction
+void reportProfile(simulator* sim, profileLine* lines, int lineCount, char* profFilename)
+{
+	unsigned long (*hot)[2] = allocateZeroedMemory(lineCount + HOT_LIST_SIZE + 1, sizeof(*hot));
+	profileLabel* labels = allocateZeroedMemory(lineCount + 1, sizeof(profileLabel));
+	profileLoop* loops = allocateZeroedMemory(lineCount + 1, sizeof(profileLoop));
+	int hotCount = 0, labelCount = 0, loopCount = 0;
+	double total = sim->steps > 0 ? (double)sim->steps : 1.0;
+
+	// Without a listing, every executed address stands for a line of its own
+	if (lineCount == 0)
+	{
+		for (int x = 0; x < SIMULATOR_MEMORY_SIZE && hotCount < HOT_LIST_SIZE; x++)
+		{
+			if (sim->counts[x] > 0)
+			{
+				hot[hotCount][0] = sim->counts[x];
+				hot[hotCount++][1] = x;
+				qsort(hot, hotCount, sizeof(*hot), compareProfileLines);
+			}
+		}
+		printf("\nHot Addresses\n%10s  %6s  %-6s\n", "Count", "%", "Address");
+		for (int x = 0; x < hotCount; x++)
+		{
+			printf("%10lu  %6.2f  %06lX\n", hot[x][0], 100.0 * hot[x][0] / total, hot[x][1]);
+		}
+		releaseMemory(hot);
+		releaseMemory(labels);
+		releaseMemory(loops);
+		return;
+	}
+
+	for (int x = 0; x < lineCount; x++)
+	{
+		profileLine* line = &lines[x];
+		unsigned long count = line->instruction && line->address >= 0 ? sim->counts[line->address] : 0;
+
+		if (count > 0)
+		{
+			hot[hotCount][0] = count;
+			hot[hotCount++][1] = x;
+		}
+		if (line->label[0] != '\0' && line->address >= 0)
+		{
+			strcpy(labels[labelCount].label, line->label);
+			labels[labelCount++].address = line->address;
+		}
+		if (labelCount > 0)
+		{
+			labels[labelCount - 1].count += count;
+		}
+
+		// A taken jump back to an earlier address closes a loop; subroutine calls and returns do not
+		if (count > 0 && sim->taken[line->address] > 0 && sim->targets[line->address] <= line->address &&
+			decodeOpcode(readMemoryByte(&sim->memory, line->address))->value != OP_JSUB &&
+			decodeOpcode(readMemoryByte(&sim->memory, line->address))->value != OP_RSUB)
+		{
+			profileLoop* loop = &loops[loopCount++];
+			loop->first = sim->targets[line->address];
+			loop->last = line->address;
+			loop->iterations = sim->taken[line->address];
+			for (int y = 0; y < lineCount; y++)
+			{
+				if (lines[y].instruction && lines[y].address >= loop->first && lines[y].address <= loop->last)
+				{
+					loop->instructions += sim->counts[lines[y].address];
+					if (lines[y].address == loop->first && loop->label[0] == '\0')
+					{
+						strcpy(loop->label, lines[y].label);
+					}
+				}
+			}
+		}
+	}
+	qsort(hot, hotCount, sizeof(*hot), compareProfileLines);
+	qsort(labels, labelCount, sizeof(profileLabel), compareProfileLabels);
+	qsort(loops, loopCount, sizeof(profileLoop), compareProfileLoops);
+
+	printf("\nHot Lines\n%10s  %6s  %s\n", "Count", "%", "Listing Line");
+	for (int x = 0; x < hotCount && x < HOT_LIST_SIZE; x++)
+	{
+		printf("%10lu  %6.2f  %s\n", hot[x][0], 100.0 * hot[x][0] / total, lines[hot[x][1]].text);
+	}
+	printf("\nHot Labels\n%10s  %6s  %-6s  %s\n", "Count", "%", "Label", "Address");
+	for (int x = 0; x < labelCount && x < HOT_LIST_SIZE && labels[x].count > 0; x++)
+	{
+		printf("%10lu  %6.2f  %-6s  %06X\n", labels[x].count, 100.0 * labels[x].count / total, labels[x].label, labels[x].address);
+	}
+	printf("\nHot Loops\n%10s  %10s  %6s  %-6s  %s\n", "Iterations", "Count", "%", "Label", "Addresses");
+	for (int x = 0; x < loopCount && x < HOT_LIST_SIZE; x++)
+	{
+		printf("%10lu  %10lu  %6.2f  %-6s  %06X-%06X\n", loops[x].iterations, loops[x].instructions, 100.0 * loops[x].instructions / total, loops[x].label, loops[x].first, loops[x].last);
+	}
+
+	// The annotated listing puts the count and share of each instruction in front of its line
+	FILE* file = fopen(profFilename, "w");
+	for (int x = 0; file != NULL && x < lineCount; x++)
+	{
+		if (lines[x].instruction && lines[x].address >= 0)
+		{
+			fprintf(file, "%10u %6.2f  %s\n", sim->counts[lines[x].address], 100.0 * sim->counts[lines[x].address] / total, lines[x].text);
+		}
+		else
+		{
+			fprintf(file, "%10s %6s  %s\n", "", "", lines[x].text);
+		}
+	}
+	if (file != NULL)
+	{
+		fclose(file);
+		printf("\nAnnotated listing written to %s\n", profFilename);
+	}
+
+	releaseMemory(hot);
+	releaseMemory(labels);
+	releaseMemory(loops);
+}
+
+// Runs one program of a batch on a clone of its image until it stops. Input devices are read
+// from name.XX.dev next to name.obj; output devices are captured and summarized, so runs on
+// other threads never share a file
+void runBatchProgram(batchQueue* queue, int index)
+{
+	batchRun* run = &queue->runs[index];
+	simulator sim;
+
+	if (run->image->entry < 0)
+	{
+		snprintf(run->stopReason, sizeof(run->stopReason), "could not be loaded");
+		return;
+	}
+	memset(&sim, 0, sizeof(simulator));
+	clonePagedMemory(&sim.memory, &run->image->memory);
+	sim.maxSteps = queue->maxSteps;
+	sim.devicePrefix = run->image->devicePrefix;
+	sim.captureOutput = true;
+	sim.registers[REGISTER_PC] = run->image->entry;
+	sim.registers[REGISTER_L] = HALT_ADDRESS;
+	while (executeInstruction(&sim))
+	{
+	}
+
+	run->steps = sim.steps;
+	run->pages = countMappedPages(&sim.memory);
+	run->copiedPages = sim.memory.pageCount;
+	run->completed = sim.completed;
+	strcpy(run->stopReason, sim.stopReason);
+	closeDevices(&sim, run->output);
+	releasePagedMemory(&sim.memory);
+}
+
+// Performs the task for every index of the queue, on the provided number of threads
+void runBatchTasks(batchQueue* queue, int count, void (*task)(batchQueue*, int), long threadCount)
+{
+	pthread_t* threads;
+
+	queue->count = count;
+	queue->next = 0;
+	queue->task = task;
+	if (threadCount > count)
+	{
+		threadCount = count;
+	}
+	if (threadCount <= 1)
+	{
+		runQueuedBatchTasks(queue);
+		return;
+	}
+
+	threads = allocateMemory(sizeof(pthread_t) * threadCount);
+	for (int x = 0; x < threadCount; x++)
+	{
+		pthread_create(&threads[x], NULL, runQueuedBatchTasks, queue);
+	}
+	for (int x = 0; x < threadCount; x++)
+	{
+		pthread_join(threads[x], NULL);
+	}
+	releaseMemory(threads);
+}
+
+// Thread entry point; performs the task of the queue for each index it takes until none are left
+void* runQueuedBatchTasks(void* argument)
+{
+	batchQueue* queue = (batchQueue*)argument;
+	int next;
+
+	while (true)
+	{
+		pthread_mutex_lock(&queue->lock);
+		next = queue->next++;
+		pthread_mutex_unlock(&queue->lock);
+
+		if (next >= queue->count)
+		{
+			return NULL;
+		}
+		queue->task(queue, next);
+	}
+}
+
+// Extends the sign bit of a 24-bit word
+int signExtend(int value)
+{
+	return value & WORD_SIGN ? value - (WORD_MASK + 1) : value;
+}
+
+// Runs each object file to completion on a pool of threads and reports every run. Each file
+// is loaded once into a snapshot of paged memory, and each run clones the snapshot, copying a
+// page only when the run writes to it; a file named more than once is run once per name
+// Returns the number of runs that could not be loaded or did not stop by themselves
+int simulateBatch(char* filenames[], int count, long maxSteps, int jobs)
+{
+	batchQueue queue = { NULL, NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER, maxSteps, NULL };
+	char*** sorted = allocateMemory(sizeof(char**) * count);
+	long threadCount = jobs > 0 ? jobs : sysconf(_SC_NPROCESSORS_ONLN);
+	int imageCount = 0, failures = 0, loadedPages = 0, copiedPages = 0;
+	long steps = 0;
+	struct timespec start, end;
+
+	if (threadCount > count)
+	{
+		threadCount = count;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	queue.images = allocateZeroedMemory(count, sizeof(batchImage));
+	queue.runs = allocateZeroedMemory(count, sizeof(batchRun));
+
+	// Repeated filenames share one image, found by sorting the names
+	for (int x = 0; x < count; x++)
+	{
+		sorted[x] = &filenames[x];
+	}
+	qsort(sorted, count, sizeof(char**), compareFilenames);
+	for (int x = 0; x < count; x++)
+	{
+		char** name = sorted[x];
+
+		if (x == 0 || strcmp(*name, *sorted[x - 1]) != 0)
+		{
+			queue.images[imageCount++].filename = *name;
+		}
+		queue.runs[name - filenames].image = &queue.images[imageCount - 1];
+	}
+
+	runBatchTasks(&queue, imageCount, loadBatchImage, threadCount);
+	runBatchTasks(&queue, count, runBatchProgram, threadCount);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	for (int x = 0; x < count; x++)
+	{
+		batchRun* run = &queue.runs[x];
+
+		printf("%s: %ld instructions; %s; %d pages, %d copied%s\n", filenames[x], run->steps, run->stopReason, run->pages, run->copiedPages, run->output);
+		failures += !run->completed;
+		steps += run->steps;
+		copiedPages += run->copiedPages;
+	}
+	for (int x = 0; x < imageCount; x++)
+	{
+		loadedPages += countMappedPages(&queue.images[x].memory);
+		releasePagedMemory(&queue.images[x].memory);
+		releaseMemory(queue.images[x].devicePrefix);
+	}
+
+	double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+	printf("\nBatch: %d runs of %d files, %d failed; %ld instructions in %.3f s (%.1f million per second) on %ld thread%s\n",
+		count, imageCount, failures, steps, elapsed, elapsed > 0 ? steps / elapsed / 1000000.0 : 0.0, threadCount, threadCount == 1 ? "" : "s");
+	printf("Memory: %d pages loaded, %d pages copied or allocated by the runs\n", loadedPages, copiedPages);
+
+	releaseMemory(sorted);
+	releaseMemory(queue.images);
+	releaseMemory(queue.runs);
+	return failures;
+}
+
+// Records why the simulation stopped
+void stopSimulation(simulator* sim, const char* reason, int address)
+{
+	snprintf(sim->stopReason, sizeof(sim->stopReason), "%s 0x%X", reason, address);
+}
+
+// Writes a 24-bit word to the address
+// Returns true if the address is in memory; otherwise, false
+bool writeWord(pagedMemory* memory, int address, int value)
+{
+	if (address < 0 || address + 3 > SIMULATOR_MEMORY_SIZE)
+	{
+		return false;
+	}
+	writeMemoryByte(memory, address, value >> 16);
+	writeMemoryByte(memory, address + 1, value >> 8);
+	writeMemoryByte(memory, address + 2, value);
+	return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#define DEFAULT_MAX_STEPS 100000000L
+#define SIMULATOR_DEVICE_COUNT 256
+#define SIMULATOR_MEMORY_SIZE (MEMORY_PAGE_COUNT * MEMORY_PAGE_SIZE)
+
+// Used to store the state of the SIC/XE machine and the profile of one run
+typedef struct simulator
+{
+	pagedMemory memory;
+	int registers[10];        // A, X, L, B, S, T, F (unused), -, PC, SW by register number
+	int conditionCode;        // -1, 0 or 1 after a comparison
+	long steps;               // Instructions executed
+	long maxSteps;
+	uint32_t* counts;         // Executions of the instruction at each address; NULL if not profiled
+	uint32_t* taken;          // Taken jumps of the instruction at each address
+	int* targets;             // Address the instruction at each address last jumped to
+	char* devicePrefix;       // Prepended to the XX.dev file of each device
+	bool captureOutput;       // Keeps output devices in memory instead of writing their files
+	FILE* devices[SIMULATOR_DEVICE_COUNT]; // Files opened for TD, RD and WD by device number
+	char* outputs[SIMULATOR_DEVICE_COUNT]; // Captured output by device number
+	size_t outputSizes[SIMULATOR_DEVICE_COUNT];
+	bool completed;           // True if the program returned or halted by itself
+	char stopReason[80];
+} simulator;
+
+int profileFiles(char* filenames[], int count, long maxSteps);
+int simulateBatch(char* filenames[], int count, long maxSteps, int jobs);
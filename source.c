@@ -0,0 +1,199 @@
+#include "headers.h"
+#include <libgen.h>
+#include <limits.h>
+
+#define INCLUDE_OPERATION "INCLUDE"
+#define INITIAL_LINE_CAPACITY 64
+#define SINGLE_QUOTE '\''
+
+void includeSourceFile(macroTable* macros, sourceLines* source, char* filename, char* stack[], int depth);
+void releaseMacroTableCleanup(void* macros);
+void reserveSourceLines(sourceLines* source, int count);
+
+// Adds a copy of the provided statement to the end of the source lines
+void appendSourceLine(sourceLines* source, char* line)
+{
+	reserveSourceLines(source, 1);
+	strncpy(source->lines[source->count], line, INPUT_BUF_SIZE - 1);
+	source->lines[source->count][INPUT_BUF_SIZE - 1] = '\0';
+	source->count++;
+}
+
+// Adds a copy of a block of statements taken from another set of source lines
+void appendSourceLines(sourceLines* source, sourceLines* from, int first, int count)
+{
+	reserveSourceLines(source, count);
+	memcpy(source->lines[source->count], from->lines[first], (size_t)count * INPUT_BUF_SIZE);
+	source->count += count;
+}
+
+// Returns a new filename using the provided filename and extension
+char* createFilename(char* filename, const char* extension)
+{
+	char* temp = (char*)allocateMemory(sizeof(char) * (strlen(filename) + strlen(extension) + 1));
+	char* dot = strrchr(filename, '.');
+	
+	int n = dot != NULL ? dot - filename : strlen(filename);
+	strncpy(temp, filename, n);
+	temp[n] = '\0';
+	strcat(temp, extension);
+	return temp;
+}
+
+// Releases the statements held by the source lines
+void freeSourceLines(sourceLines* source)
+{
+	releaseMemory(source->lines);
+	source->lines = NULL;
+	source->count = 0;
+	source->capacity = 0;
+}
+
+// Tests whether the statement is an INCLUDE directive and copies the quoted filename it names,
+// relative to the directory of the including file unless the name is an absolute path
+// Returns true if the statement is an INCLUDE directive; otherwise, false
+bool getIncludeFilename(char* line, char* parent, char* filename)
+{
+	char operation[SEGMENT_SIZE];
+	char* name = line + (SEGMENT_SIZE - 1) * 2;
+	char* end;
+	int x;
+
+	if (line[0] == '#' || strlen(line) < SEGMENT_SIZE - 1)
+	{
+		return false;
+	}
+	for (x = 0; x < SEGMENT_SIZE - 1 && line[SEGMENT_SIZE - 1 + x] != '\0' && !isspace(line[SEGMENT_SIZE - 1 + x]); x++)
+	{
+		operation[x] = line[SEGMENT_SIZE - 1 + x];
+	}
+	operation[x] = '\0';
+	if (strcmp(operation, INCLUDE_OPERATION) != 0)
+	{
+		return false;
+	}
+
+	// The statement takes no label and exactly one quoted filename
+	if (!isspace(line[0]) || strlen(line) <= (SEGMENT_SIZE - 1) * 2 || name[0] != SINGLE_QUOTE || (end = strchr(name + 1, SINGLE_QUOTE)) == NULL || end == name + 1)
+	{
+		char statement[INPUT_BUF_SIZE];
+		snprintf(statement, INPUT_BUF_SIZE, "%s", line + strspn(line, " \t"));
+		statement[strcspn(statement, "\r\n")] = '\0';
+		displayError(ILLEGAL_INCLUDE, statement);
+		exit(-1);
+	}
+	if (name[1] == '/')
+	{
+		snprintf(filename, PATH_MAX, "%.*s", (int)(end - name - 1), name + 1);
+	}
+	else
+	{
+		char* directory = duplicateString(parent);
+		snprintf(filename, PATH_MAX, "%s/%.*s", dirname(directory), (int)(end - name - 1), name + 1);
+		releaseMemory(directory);
+	}
+	return true;
+}
+
+// Passes the statements of a source file to macro processing, replacing each INCLUDE directive
+// with the statements of the file it names. Only included files go through the include cache.
+// The stack holds the files being included, so a file that includes itself, directly or
+// through other files, is reported
+void includeSourceFile(macroTable* macros, sourceLines* source, char* filename, char* stack[], int depth)
+{
+	parsedFile* file = depth == 0 ? readParsedFile(filename) : readIncludedFile(filename);
+	errorCleanup cleanup;
+
+	if (file == NULL)
+	{
+		displayError(FILE_NOT_FOUND, filename);
+		exit(-1);
+	}
+	pushErrorCleanup(&cleanup, releaseIncludedFileCleanup, file);
+	for (int x = 0; x < depth; x++)
+	{
+		if (depth == MAX_INCLUDE_DEPTH || strcmp(stack[x], file->path) == 0)
+		{
+			displayError(ILLEGAL_INCLUDE, filename);
+			exit(-1);
+		}
+	}
+
+	stack[depth] = file->path;
+	for (int x = 0; x < file->lines.count; x++)
+	{
+		if (file->statements[x].include >= 0)
+		{
+			includeSourceFile(macros, source, file->includes[file->statements[x].include], stack, depth + 1);
+		}
+		else
+		{
+			processMacroStatement(macros, source, file->lines.lines[x], &file->statements[x]);
+		}
+	}
+	stack[depth] = NULL;
+	popErrorCleanup(&cleanup);
+	releaseIncludedFile(file);
+}
+
+// Reads the provided SIC/XE source file with the files it includes and expands its macro invocations
+void loadSourceFile(char* filename, sourceLines* source)
+{
+	macroTable macros = { 0 };
+	char* stack[MAX_INCLUDE_DEPTH + 1];
+	errorCleanup cleanup;
+
+	pushErrorCleanup(&cleanup, releaseMacroTableCleanup, &macros);
+	includeSourceFile(&macros, source, filename, stack, 0);
+
+	finishMacros(&macros);
+	popErrorCleanup(&cleanup);
+	freeMacroTable(&macros);
+}
+
+// Releases a macro table registered with pushErrorCleanup()
+void releaseMacroTableCleanup(void* macros)
+{
+	freeMacroTable(macros);
+}
+
+// Makes room for the provided number of additional statements
+void reserveSourceLines(sourceLines* source, int count)
+{
+	int capacity = source->capacity > 0 ? source->capacity : INITIAL_LINE_CAPACITY;
+
+	if (source->count + count <= source->capacity)
+	{
+		return;
+	}
+	while (capacity < source->count + count)
+	{
+		capacity *= 2;
+	}
+	source->lines = resizeMemory(source->lines, (size_t)capacity * INPUT_BUF_SIZE);
+	memset(source->lines[source->capacity], '\0', (size_t)(capacity - source->capacity) * INPUT_BUF_SIZE);
+	source->capacity = capacity;
+}
+
+// Writes the buffer to the file unless the file already holds exactly those bytes, so
+// programs watching the output files only see the ones that changed
+// Returns true if the file was written; otherwise, false
+bool writeFileIfChanged(char* filename, char* buffer, size_t size)
+{
+	FILE* file = fopen(filename, "rb");
+	bool changed = true;
+
+	if (file != NULL)
+	{
+		char* current = allocateMemory(size + 1);
+		changed = fread(current, 1, size + 1, file) != size || memcmp(current, buffer, size) != 0;
+		releaseMemory(current);
+		fclose(file);
+	}
+	if (changed && (file = fopen(filename, "wb")) != NULL)
+	{
+		fwrite(buffer, 1, size, file);
+		fclose(file);
+	}
+	return changed;
+}
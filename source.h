@@ -0,0 +1,26 @@
+#pragma once
+
+// Used to store the statements of a source file after macro expansion
+typedef struct sourceLines
+{
+	char (*lines)[INPUT_BUF_SIZE];
+	int count;
+	int capacity;
+} sourceLines;
+
+// Used to store one statement split into its label, operation and operand columns
+typedef struct sourceStatement
+{
+	char label[INPUT_BUF_SIZE];
+	char operation[INPUT_BUF_SIZE];
+	char operand[INPUT_BUF_SIZE];
+	int include; // Index of the file an INCLUDE directive names; -1 for other statements
+} sourceStatement;
+
+void appendSourceLine(sourceLines* source, char* line);
+void appendSourceLines(sourceLines* source, sourceLines* from, int first, int count);
+char* createFilename(char* filename, const char* extension);
+void freeSourceLines(sourceLines* source);
+bool getIncludeFilename(char* line, char* parent, char* filename);
+void loadSourceFile(char* filename, sourceLines* source);
+bool writeFileIfChanged(char* filename, char* buffer, size_t size);
@@ -2,7 +2,6 @@
 
 #define MOD_SIZE 10
 #define SYMBOL_TABLE_SEGMENTS 10
-#define SYMBOL_TABLE_SIZE 100
 
 int computeHash(char* input);
 bool isDirectAddressing(char* string);
@@ -20,39 +19,54 @@ int computeHash(char* symbolName)
 }
 
 // Print the contents of the Symbol Table to the screen
-void displaySymbolTable(symbol* symbolTable[])
+void displaySymbolTable(FILE* file, symbol* symbolTable[])
 {
-	printf("\n%-5s  %-6s  %-7s\n", "Index", " Name ", "Address");
-	printf("%-5s  %-6s  %-7s\n", "-----", "------", "-------");
+	fprintf(file, "\n%-5s  %-6s  %-7s\n", "Index", " Name ", "Address");
+	fprintf(file, "%-5s  %-6s  %-7s\n", "-----", "------", "-------");
 	for (int x = 0; x < SYMBOL_TABLE_SIZE; x++)
 	{
 		if (symbolTable[x] == NULL)
 			continue;
-		printf("%5d  %-6s  0x%X\n", x, symbolTable[x]->name, symbolTable[x]->address);
+		fprintf(file, "%5d  %-6s  0x%X\n", x, symbolTable[x]->name, symbolTable[x]->address);
 	}
 }
 
-// Returns the address of the specified string if found; otherwise, -1
-int getSymbolAddress(struct symbol* symbolArray[], char* string)
+// Releases every symbol and sets each element of the Symbol Table to NULL
+void freeSymbolTable(symbol* symbolTable[])
 {
-	int hashIndex;
-	
-	if(!isDirectAddressing(string))
+	for (int x = 0; x < SYMBOL_TABLE_SIZE; x++)
 	{
-		memmove(string, &(string[1]), strlen(&(string[1])) + 1);
+		releaseMemory(symbolTable[x]);
+		symbolTable[x] = NULL;
 	}
-	hashIndex = computeHash(string);
-	
-	while (symbolArray[hashIndex] != NULL && hashIndex < SYMBOL_TABLE_SIZE)
+}
+
+// Returns the symbol with the specified name if found; otherwise, NULL
+symbol* findSymbol(struct symbol* symbolTable[], char* symbolName)
+{
+	int hashIndex = computeHash(symbolName);
+
+	while (hashIndex < SYMBOL_TABLE_SIZE && symbolTable[hashIndex] != NULL)
 	{
-		if (strcmp(symbolArray[hashIndex]->name, string) == 0)
+		if (strcmp(symbolTable[hashIndex]->name, symbolName) == 0)
 		{
-			return symbolArray[hashIndex]->address;
+			return symbolTable[hashIndex];
 		}
 		hashIndex++;
 	}
-	displayError(UNKNOWN_SYMBOL, string);
-	exit(-1);
+	return NULL;
+}
+
+// Copies the operand without its Immediate '#', Indirect '@' and Index ",X" characters
+void getOperandSymbol(char* operand, char* symbolName)
+{
+	char* index;
+
+	strcpy(symbolName, isDirectAddressing(operand) ? operand : &(operand[1]));
+	if ((index = strstr(symbolName, ",X")) != NULL)
+	{
+		*index = '\0';
+	}
 }
 
 // Set each element of the Symbol Table to NULL
@@ -65,7 +79,7 @@ void initializeSymbolTable(symbol* symbolTable[])
 }
 
 // Add a symbol to an empty location in the Symbol Table
-void insertSymbol(symbol* symbolTable[], char symbolName[], int symbolAddress)
+symbol* insertSymbol(symbol* symbolTable[], char symbolName[], int symbolAddress)
 {
 	int hashIndex = computeHash(symbolName);
 
@@ -73,12 +87,11 @@ void insertSymbol(symbol* symbolTable[], char symbolName[], int symbolAddress)
 	{
 		if (symbolTable[x] == NULL)
 		{
-			symbolTable[x] = (symbol*)malloc(sizeof(symbol));
+			symbolTable[x] = (symbol*)allocateMemory(sizeof(symbol));
 			strcpy(symbolTable[x]->name, symbolName);
 			symbolTable[x]->address = symbolAddress;
-			
-			
-			return;
+			symbolTable[x]->block = 0;
+			return symbolTable[x];
 		}
 		else
 		{
@@ -89,6 +102,7 @@ void insertSymbol(symbol* symbolTable[], char symbolName[], int symbolAddress)
 			}
 		}
 	}
+	return NULL;
 }
 
 // Tests whether the provided string contains an Indirect '@' or Immediate '#' symbol
@@ -10,17 +10,22 @@
 **********************************************/
 #pragma once
 
+#define SYMBOL_TABLE_SIZE 100
+
 // Used to store data about a symbol
 typedef struct symbol
 {
 	char name[NAME_SIZE];
 	int address;
+	int block; // Program block the symbol is defined in
 } symbol;
 
 // Pass 1 functions
-void displaySymbolTable(struct symbol* symbolTable[]);
+void displaySymbolTable(FILE* file, struct symbol* symbolTable[]);
+void freeSymbolTable(struct symbol* symbolTable[]);
 void initializeSymbolTable(struct symbol* symbolTable[]);
-void insertSymbol(struct symbol* symbolTable[], char symbolName[], int symbolAddress);
+struct symbol* insertSymbol(struct symbol* symbolTable[], char symbolName[], int symbolAddress);
 
 // Pass 2 functions
-int getSymbolAddress(struct symbol* symbolArray[], char* string);
\ No newline at end of file
+struct symbol* findSymbol(struct symbol* symbolTable[], char* symbolName);
+void getOperandSymbol(char* operand, char* symbolName);
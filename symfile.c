@@ -0,0 +1,276 @@
+#include "headers.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MIN_HASH_SIZE 8
+
+bool checkSymbolFile(symbolFile* file);
+int compareSymbolFileEntries(const void* first, const void* second);
+uint32_t hashSymbolFileName(char* name);
+
+// Checks that every table of a mapped symbol file lies inside the file and that every index
+// stored in it is in range, so a truncated or corrupt file is rejected before it is read
+// Returns true if the file can be read; otherwise, false
+bool checkSymbolFile(symbolFile* file)
+{
+	symbolFileHeader* header = file->header;
+	bool emptySlot = false;
+
+	if (memcmp(header->magic, SYMBOL_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+		header->version != SYMBOL_FILE_VERSION || header->byteOrder != SYMBOL_FILE_BYTE_ORDER ||
+		header->hashSize == 0 || (header->hashSize & (header->hashSize - 1)) != 0 ||
+		header->sectionOffset % sizeof(uint32_t) != 0 || header->symbolOffset % sizeof(uint32_t) != 0 || header->hashOffset % sizeof(uint32_t) != 0 ||
+		header->sectionOffset + (uint64_t)header->sectionCount * sizeof(symbolFileSection) > file->size ||
+		header->symbolOffset + (uint64_t)header->symbolCount * sizeof(symbolFileEntry) > file->size ||
+		header->hashOffset + (uint64_t)header->hashSize * sizeof(uint32_t) > file->size)
+	{
+		return false;
+	}
+	file->sections = (symbolFileSection*)((char*)file->map + header->sectionOffset);
+	file->symbols = (symbolFileEntry*)((char*)file->map + header->symbolOffset);
+	file->hash = (uint32_t*)((char*)file->map + header->hashOffset);
+
+	for (uint32_t x = 0; x < header->sectionCount; x++)
+	{
+		if ((uint64_t)file->sections[x].firstSymbol + file->sections[x].symbolCount > header->symbolCount)
+		{
+			return false;
+		}
+	}
+	for (uint32_t x = 0; x < header->symbolCount; x++)
+	{
+		if (file->symbols[x].section >= header->sectionCount)
+		{
+			return false;
+		}
+	}
+
+	// Probing stops at an empty slot, so the index needs at least one
+	for (uint32_t x = 0; x < header->hashSize; x++)
+	{
+		if (file->hash[x] > header->symbolCount)
+		{
+			return false;
+		}
+		emptySlot |= file->hash[x] == 0;
+	}
+	return emptySlot;
+}
+
+// Releases a symbol file opened by openSymbolFile()
+void closeSymbolFile(symbolFile* file)
+{
+	if (file->map != NULL)
+	{
+		munmap(file->map, file->size);
+	}
+	memset(file, 0, sizeof(symbolFile));
+}
+
+// Orders symbol file entries by section, address, then name, for qsort()
+int compareSymbolFileEntries(const void* first, const void* second)
+{
+	const symbolFileEntry* left = (const symbolFileEntry*)first;
+	const symbolFileEntry* right = (const symbolFileEntry*)second;
+
+	if (left->section != right->section)
+	{
+		return left->section < right->section ? -1 : 1;
+	}
+	if (left->address != right->address)
+	{
+		return left->address < right->address ? -1 : 1;
+	}
+	return strncmp(left->name, right->name, SYMBOL_FILE_NAME_SIZE);
+}
+
+// Computes the FNV-1a hash of a NUL-padded symbol file name
+uint32_t hashSymbolFileName(char* name)
+{
+	return hashBytes(FNV32_OFFSET_BASIS, name, strnlen(name, SYMBOL_FILE_NAME_SIZE));
+}
+
+// Finds the symbol of the control section at the provided address, or the closest one before
+// it, with a binary search. Relocatable sections all start at zero, so the section is required
+// Returns the symbol; NULL if every symbol of the section follows the address
+symbolFileEntry* lookupSymbolAddress(symbolFile* file, uint32_t section, uint32_t address)
+{
+	symbolFileEntry* symbols;
+	int low = 0, high;
+
+	if (section >= file->header->sectionCount)
+	{
+		return NULL;
+	}
+	symbols = &file->symbols[file->sections[section].firstSymbol];
+	high = file->sections[section].symbolCount;
+
+	// Count the symbols located at or before the address
+	while (low < high)
+	{
+		int mid = (low + high) / 2;
+		if (symbols[mid].address <= address)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+	if (low == 0)
+	{
+		return NULL;
+	}
+
+	// Prefer the first name at that address
+	while (low > 1 && symbols[low - 2].address == symbols[low - 1].address)
+	{
+		low--;
+	}
+	return &symbols[low - 1];
+}
+
+// Finds a symbol by name through the hash index
+// Returns the symbol; NULL if not found
+symbolFileEntry* lookupSymbolName(symbolFile* file, char* name)
+{
+	uint32_t mask = file->header->hashSize - 1;
+
+	for (uint32_t x = hashSymbolFileName(name) & mask; file->hash[x] != 0; x = (x + 1) & mask)
+	{
+		symbolFileEntry* entry = &file->symbols[file->hash[x] - 1];
+		if (strncmp(entry->name, name, SYMBOL_FILE_NAME_SIZE) == 0)
+		{
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+// Maps a symbol file into memory and checks its contents
+// Returns true if the file is a readable symbol file of the supported version; otherwise, false
+bool openSymbolFile(char* filename, symbolFile* file)
+{
+	struct stat status;
+	int descriptor = open(filename, O_RDONLY);
+
+	memset(file, 0, sizeof(symbolFile));
+	if (descriptor < 0)
+	{
+		return false;
+	}
+	if (fstat(descriptor, &status) < 0 || (size_t)status.st_size < sizeof(symbolFileHeader))
+	{
+		close(descriptor);
+		return false;
+	}
+	file->size = status.st_size;
+	file->map = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	close(descriptor);
+	if (file->map == MAP_FAILED)
+	{
+		file->map = NULL;
+		return false;
+	}
+
+	file->header = (symbolFileHeader*)file->map;
+	if (!checkSymbolFile(file))
+	{
+		closeSymbolFile(file);
+		return false;
+	}
+	return true;
+}
+
+// Writes the symbols of every control section to a binary symbol file
+void writeSymbolFile(controlSection* sections, int count, char* filename)
+{
+	symbolFileHeader header = { { 0 }, 0, 0, 0, 0, 0, 0, 0, 0 };
+	symbolFileSection* sectionEntries = allocateZeroedMemory(count, sizeof(symbolFileSection));
+	symbolFileEntry* entries;
+	uint32_t* hash;
+	uint32_t symbolCount = 0;
+	uint32_t hashSize = MIN_HASH_SIZE;
+	char* text = NULL;
+	size_t size = 0;
+	FILE* file;
+
+	for (int x = 0; x < count; x++)
+	{
+		for (int y = 0; y < SYMBOL_TABLE_SIZE; y++)
+		{
+			symbolCount += sections[x].symbols[y] != NULL;
+		}
+	}
+	while (hashSize < symbolCount * 2)
+	{
+		hashSize *= 2;
+	}
+
+	// Collect the sections and symbols, then sort the symbols by address
+	entries = allocateZeroedMemory(symbolCount + 1, sizeof(symbolFileEntry));
+	symbolCount = 0;
+	for (int x = 0; x < count; x++)
+	{
+		strncpy(sectionEntries[x].name, sections[x].name, SYMBOL_FILE_NAME_SIZE - 1);
+		sectionEntries[x].start = sections[x].addresses.start;
+		sectionEntries[x].length = sections[x].addresses.end - sections[x].addresses.start;
+		for (int y = 0; y < SYMBOL_TABLE_SIZE; y++)
+		{
+			if (sections[x].symbols[y] != NULL)
+			{
+				strncpy(entries[symbolCount].name, sections[x].symbols[y]->name, SYMBOL_FILE_NAME_SIZE - 1);
+				entries[symbolCount].address = sections[x].symbols[y]->address;
+				entries[symbolCount].section = x;
+				symbolCount++;
+			}
+		}
+	}
+	qsort(entries, symbolCount, sizeof(symbolFileEntry), compareSymbolFileEntries);
+	for (uint32_t x = symbolCount; x > 0; x--)
+	{
+		sectionEntries[entries[x - 1].section].firstSymbol = x - 1;
+		sectionEntries[entries[x - 1].section].symbolCount++;
+	}
+
+	// Index the names with linear probing; a name defined by several sections keeps the first
+	hash = allocateZeroedMemory(hashSize, sizeof(uint32_t));
+	for (uint32_t x = 0; x < symbolCount; x++)
+	{
+		uint32_t slot = hashSymbolFileName(entries[x].name) & (hashSize - 1);
+		while (hash[slot] != 0 && strncmp(entries[hash[slot] - 1].name, entries[x].name, SYMBOL_FILE_NAME_SIZE) != 0)
+		{
+			slot = (slot + 1) & (hashSize - 1);
+		}
+		if (hash[slot] == 0)
+		{
+			hash[slot] = x + 1;
+		}
+	}
+
+	memcpy(header.magic, SYMBOL_FILE_MAGIC, sizeof(header.magic));
+	header.version = SYMBOL_FILE_VERSION;
+	header.byteOrder = SYMBOL_FILE_BYTE_ORDER;
+	header.sectionCount = count;
+	header.symbolCount = symbolCount;
+	header.hashSize = hashSize;
+	header.sectionOffset = sizeof(symbolFileHeader);
+	header.symbolOffset = header.sectionOffset + count * sizeof(symbolFileSection);
+	header.hashOffset = header.symbolOffset + symbolCount * sizeof(symbolFileEntry);
+
+	file = openMemoryStream(&text, &size);
+	fwrite(&header, sizeof(symbolFileHeader), 1, file);
+	fwrite(sectionEntries, sizeof(symbolFileSection), count, file);
+	fwrite(entries, sizeof(symbolFileEntry), symbolCount, file);
+	fwrite(hash, sizeof(uint32_t), hashSize, file);
+	fclose(file);
+	writeFileIfChanged(filename, text, size);
+	releaseMemory(text);
+
+	releaseMemory(sectionEntries);
+	releaseMemory(entries);
+	releaseMemory(hash);
+}
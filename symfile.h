@@ -0,0 +1,62 @@
+#pragma once
+
+#define SYMBOL_FILE_BYTE_ORDER 0x01020304u
+#define SYMBOL_FILE_MAGIC "SXSY"
+#define SYMBOL_FILE_NAME_SIZE 8
+#define SYMBOL_FILE_VERSION 2
+
+struct controlSection;
+
+// Binary symbol file layout; every field is a 32-bit value in the byte order of the host that
+// wrote the file, recorded by byteOrder, so the file can be mapped and read in place:
+//   symbolFileHeader
+//   symbolFileSection[sectionCount]  control sections in source order
+//   symbolFileEntry[symbolCount]     symbols sorted by section, address, then name
+//   uint32_t[hashSize]               name index: entry index + 1, or 0 for an empty slot
+typedef struct symbolFileHeader
+{
+	char magic[4];          // SYMBOL_FILE_MAGIC
+	uint32_t version;       // SYMBOL_FILE_VERSION
+	uint32_t byteOrder;     // SYMBOL_FILE_BYTE_ORDER as the writing host stores it
+	uint32_t sectionCount;
+	uint32_t symbolCount;
+	uint32_t hashSize;      // Slots in the name index; a power of two
+	uint32_t sectionOffset; // Byte offsets from the start of the file
+	uint32_t symbolOffset;
+	uint32_t hashOffset;
+} symbolFileHeader;
+
+// Used to store one control section of the symbol file
+typedef struct symbolFileSection
+{
+	char name[SYMBOL_FILE_NAME_SIZE];
+	uint32_t start;
+	uint32_t length;
+	uint32_t firstSymbol;   // Index of the first symbol of the section
+	uint32_t symbolCount;
+} symbolFileSection;
+
+// Used to store one symbol of the symbol file
+typedef struct symbolFileEntry
+{
+	char name[SYMBOL_FILE_NAME_SIZE];
+	uint32_t address;
+	uint32_t section; // Index of the control section defining the symbol
+} symbolFileEntry;
+
+// Used to access a symbol file mapped into memory
+typedef struct symbolFile
+{
+	void* map;
+	size_t size;
+	symbolFileHeader* header;
+	symbolFileSection* sections;
+	symbolFileEntry* symbols;
+	uint32_t* hash;
+} symbolFile;
+
+void closeSymbolFile(symbolFile* file);
+symbolFileEntry* lookupSymbolAddress(symbolFile* file, uint32_t section, uint32_t address);
+symbolFileEntry* lookupSymbolName(symbolFile* file, char* name);
+bool openSymbolFile(char* filename, symbolFile* file);
+void writeSymbolFile(struct controlSection* sections, int count, char* filename);
@@ -0,0 +1,160 @@
+#include "headers.h"
+#include <libgen.h>
+#include <limits.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <time.h>
+#include <unistd.h>
+
+#define INITIAL_WATCH_CAPACITY 8
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO)
+#define WATCH_EVENT_BUFFER_SIZE 4096
+#define WATCH_MESSAGE_SIZE 512
+#define WATCH_SETTLE_MILLISECONDS 50
+
+// Used to store one file followed by watch mode: the watch on its directory and its name there
+typedef struct watchedFile
+{
+	int watch;
+	char name[NAME_MAX + 1];
+} watchedFile;
+
+// Used to store the files followed by watch mode
+typedef struct watchList
+{
+	int descriptor; // inotify instance
+	watchedFile* files;
+	int count;
+	int capacity;
+} watchList;
+
+void addWatchedFile(watchList* list, char* filename);
+void followIncludedFile(char* path, void* context);
+bool readWatchEvents(watchList* list);
+void runWatchedAssembly(watchList* list, char* filename, options* settings, int (*assemble)(char*, options*));
+
+// Follows the provided file by watching its directory, so editors that save by renaming a new
+// copy over the old one are still followed. Files already followed are ignored
+void addWatchedFile(watchList* list, char* filename)
+{
+	char* directoryCopy = duplicateString(filename);
+	char* nameCopy = duplicateString(filename);
+	char* name = basename(nameCopy);
+	int watch = inotify_add_watch(list->descriptor, dirname(directoryCopy), WATCH_EVENTS);
+	bool found = watch < 0;
+
+	for (int x = 0; x < list->count && !found; x++)
+	{
+		found = list->files[x].watch == watch && strcmp(list->files[x].name, name) == 0;
+	}
+	if (!found)
+	{
+		if (list->count == list->capacity)
+		{
+			list->capacity = list->capacity > 0 ? list->capacity * 2 : INITIAL_WATCH_CAPACITY;
+			list->files = resizeMemory(list->files, sizeof(watchedFile) * list->capacity);
+		}
+		list->files[list->count].watch = watch;
+		snprintf(list->files[list->count].name, NAME_MAX + 1, "%s", name);
+		list->count++;
+	}
+	releaseMemory(directoryCopy);
+	releaseMemory(nameCopy);
+}
+
+// Follows a file read by the assembly; called by the include cache with the watch list
+void followIncludedFile(char* path, void* context)
+{
+	addWatchedFile((watchList*)context, path);
+}
+
+// Reads the pending events of the directory watches
+// Returns true if one of them names a followed file; otherwise, false
+bool readWatchEvents(watchList* list)
+{
+	char buffer[WATCH_EVENT_BUFFER_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+	bool changed = false;
+	ssize_t length = read(list->descriptor, buffer, sizeof(buffer));
+
+	for (char* next = buffer; length > 0 && next < buffer + length; )
+	{
+		struct inotify_event* event = (struct inotify_event*)next;
+		for (int x = 0; x < list->count && event->len > 0; x++)
+		{
+			changed |= list->files[x].watch == event->wd && strcmp(list->files[x].name, event->name) == 0;
+		}
+		next += sizeof(struct inotify_event) + event->len;
+	}
+	return changed;
+}
+
+// Assembles the source file in this process and reports the result and the time it took, so
+// the include cache and the tables built at startup stay warm between saves. An error in the
+// source returns here through the error recovery used by --regress, which only covers the
+// calling thread, so the sections are assembled on this thread. The cleanups the assembly
+// registers release what it held. Every file the assembly reads is followed from then on
+void runWatchedAssembly(watchList* list, char* filename, options* settings, int (*assemble)(char*, options*))
+{
+	char message[WATCH_MESSAGE_SIZE] = { '\0' };
+	options watchSettings = *settings;
+	struct timespec start, end;
+	jmp_buf recovery;
+	volatile int result = -1;
+
+	watchSettings.jobs = 1;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	reportIncludedFiles(followIncludedFile, list);
+	recoverFromErrors(&recovery, message, WATCH_MESSAGE_SIZE);
+	if (setjmp(recovery) == 0)
+	{
+		result = assemble(filename, &watchSettings);
+	}
+	recoverFromErrors(NULL, NULL, 0);
+	reportIncludedFiles(NULL, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double elapsed = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+	if (result == 0)
+	{
+		printf("\nAssembled %s in %.1f ms; watching %d files for changes\n", filename, elapsed, list->count);
+	}
+	else
+	{
+		printf("\n%sAssembly of %s failed; watching %d files for changes\n", message, filename, list->count);
+	}
+	fflush(stdout);
+}
+
+// Assembles the source file, then again each time it or a file it includes is saved until
+// the process is stopped. Saves that arrive together trigger one assembly
+// Returns a non-zero value if the file cannot be watched
+int watchSourceFile(char* filename, options* settings, int (*assemble)(char*, options*))
+{
+	watchList list = { inotify_init1(IN_CLOEXEC), NULL, 0, 0 };
+
+	if (list.descriptor >= 0)
+	{
+		addWatchedFile(&list, filename);
+	}
+	if (list.count == 0)
+	{
+		displayError(FILE_NOT_FOUND, filename);
+		return -1;
+	}
+
+	runWatchedAssembly(&list, filename, settings, assemble);
+	while (true)
+	{
+		struct pollfd watch = { list.descriptor, POLLIN, 0 };
+
+		if (!readWatchEvents(&list))
+		{
+			continue;
+		}
+		while (poll(&watch, 1, WATCH_SETTLE_MILLISECONDS) > 0)
+		{
+			readWatchEvents(&list);
+		}
+		runWatchedAssembly(&list, filename, settings, assemble);
+	}
+}
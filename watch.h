@@ -0,0 +1,3 @@
+#pragma once
+
+int watchSourceFile(char* filename, options* settings, int (*assemble)(char*, options*));
@@ -0,0 +1,136 @@
+#include "headers.h"
+#include <unistd.h>
+
+static int writerCount = 0; // Writer threads running in the process
+
+void* formatListingLines(void* argument);
+
+// Formats the queued listing lines until Pass 2 has finished and every line is written
+void* formatListingLines(void* argument)
+{
+	listingWriter* writer = (listingWriter*)argument;
+	size_t tail = writer->tail;
+
+	while (true)
+	{
+		size_t head = __atomic_load_n(&writer->head, __ATOMIC_ACQUIRE);
+		if (tail == head)
+		{
+			// Sleep until a line is queued; the flag is set before head is checked again, so
+			// Pass 2 either sees the flag or its line is seen here
+			pthread_mutex_lock(&writer->lock);
+			__atomic_store_n(&writer->writerWaiting, true, __ATOMIC_SEQ_CST);
+			while (tail == __atomic_load_n(&writer->head, __ATOMIC_SEQ_CST) && !writer->finished)
+			{
+				pthread_cond_wait(&writer->queued, &writer->lock);
+			}
+			__atomic_store_n(&writer->writerWaiting, false, __ATOMIC_RELAXED);
+			if (writer->finished && tail == __atomic_load_n(&writer->head, __ATOMIC_ACQUIRE))
+			{
+				pthread_mutex_unlock(&writer->lock);
+				return NULL;
+			}
+			pthread_mutex_unlock(&writer->lock);
+			continue;
+		}
+		while (tail != head)
+		{
+			listingLine* line = &writer->lines[tail & (LISTING_RING_SIZE - 1)];
+			writer->format(writer->file, line->address, &line->segments, line->opcode, line->bytes, line->size);
+			tail++;
+		}
+		__atomic_store_n(&writer->tail, tail, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&writer->producerWaiting, __ATOMIC_SEQ_CST))
+		{
+			pthread_mutex_lock(&writer->lock);
+			pthread_cond_signal(&writer->formatted);
+			pthread_mutex_unlock(&writer->lock);
+		}
+	}
+}
+
+// Queues one listing line with the bytes a BYTE or WORD statement stores, sleeping while the
+// ring is full. Does nothing when the listing is skipped
+void queueListingLine(listingWriter* writer, int address, segment* segments, int opcode, unsigned char* bytes, int size)
+{
+	if (writer->file == NULL)
+	{
+		return;
+	}
+	if (writer->lines == NULL)
+	{
+		writer->format(writer->file, address, segments, opcode, bytes, size);
+		return;
+	}
+	if (writer->head - __atomic_load_n(&writer->tail, __ATOMIC_ACQUIRE) == LISTING_RING_SIZE)
+	{
+		pthread_mutex_lock(&writer->lock);
+		__atomic_store_n(&writer->producerWaiting, true, __ATOMIC_SEQ_CST);
+		while (writer->head - __atomic_load_n(&writer->tail, __ATOMIC_SEQ_CST) == LISTING_RING_SIZE)
+		{
+			pthread_cond_wait(&writer->formatted, &writer->lock);
+		}
+		__atomic_store_n(&writer->producerWaiting, false, __ATOMIC_RELAXED);
+		pthread_mutex_unlock(&writer->lock);
+	}
+
+	listingLine* line = &writer->lines[writer->head & (LISTING_RING_SIZE - 1)];
+	line->address = address;
+	line->opcode = opcode;
+	line->segments = *segments;
+	line->size = bytes != NULL ? size : 0;
+	if (bytes != NULL)
+	{
+		memcpy(line->bytes, bytes, size);
+	}
+	__atomic_store_n(&writer->head, writer->head + 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&writer->writerWaiting, __ATOMIC_SEQ_CST))
+	{
+		pthread_mutex_lock(&writer->lock);
+		pthread_cond_signal(&writer->queued);
+		pthread_mutex_unlock(&writer->lock);
+	}
+}
+
+// Starts the writer thread for the listing text; a NULL file skips the listing entirely.
+// Writer threads are limited to half the processors, since each runs beside the thread
+// encoding its section. With a single processor, when the limit is reached, or when the
+// caller may not start threads, the lines are formatted as they are queued
+void startListingWriter(listingWriter* writer, FILE* file, void (*format)(FILE*, int, segment*, int, unsigned char*, int), bool threaded)
+{
+	memset(writer, 0, sizeof(listingWriter));
+	writer->file = file;
+	writer->format = format;
+	if (file == NULL || !threaded)
+	{
+		return;
+	}
+	if (__atomic_add_fetch(&writerCount, 1, __ATOMIC_RELAXED) > sysconf(_SC_NPROCESSORS_ONLN) / 2)
+	{
+		__atomic_sub_fetch(&writerCount, 1, __ATOMIC_RELAXED);
+		return;
+	}
+	pthread_mutex_init(&writer->lock, NULL);
+	pthread_cond_init(&writer->queued, NULL);
+	pthread_cond_init(&writer->formatted, NULL);
+	writer->lines = allocateMemory(sizeof(listingLine) * LISTING_RING_SIZE);
+	pthread_create(&writer->thread, NULL, formatListingLines, writer);
+}
+
+// Waits for the writer thread to format the remaining lines
+void stopListingWriter(listingWriter* writer)
+{
+	if (writer->lines != NULL)
+	{
+		pthread_mutex_lock(&writer->lock);
+		writer->finished = true;
+		pthread_cond_signal(&writer->queued);
+		pthread_mutex_unlock(&writer->lock);
+		pthread_join(writer->thread, NULL);
+		__atomic_sub_fetch(&writerCount, 1, __ATOMIC_RELAXED);
+		pthread_cond_destroy(&writer->queued);
+		pthread_cond_destroy(&writer->formatted);
+		pthread_mutex_destroy(&writer->lock);
+		releaseMemory(writer->lines);
+	}
+}
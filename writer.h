@@ -0,0 +1,39 @@
+#pragma once
+
+#include <pthread.h>
+
+#define LISTING_RING_SIZE 1024 // Power of two
+
+// Used to store one listing line waiting to be formatted
+typedef struct listingLine
+{
+	int address;
+	int opcode;
+	segment segments;
+	int size;                           // Bytes stored by a BYTE or WORD statement
+	unsigned char bytes[OPERAND_SIZE];
+} listingLine;
+
+// Used to hand the listing lines of Pass 2 to a writer thread through a single-producer,
+// single-consumer ring, so formatting the listing overlaps with encoding the instructions.
+// Pass 2 only advances head and the writer thread only advances tail. A side that finds the
+// ring empty or full sleeps on a condition variable until the other side wakes it
+typedef struct listingWriter
+{
+	listingLine* lines;  // Ring of queued lines; NULL when lines are formatted as they arrive
+	size_t head;     // Lines queued by Pass 2
+	size_t tail;     // Lines formatted by the writer thread
+	bool finished;   // Set by Pass 2 once the last line is queued
+	bool writerWaiting;   // Set while the writer thread sleeps on an empty ring
+	bool producerWaiting; // Set while Pass 2 sleeps on a full ring
+	pthread_mutex_t lock; // Held only to sleep or to wake the other side
+	pthread_cond_t queued;
+	pthread_cond_t formatted;
+	FILE* file;      // Listing text; NULL when the listing is skipped
+	void (*format)(FILE*, int, segment*, int, unsigned char*, int);
+	pthread_t thread;
+} listingWriter;
+
+void queueListingLine(listingWriter* writer, int address, segment* segments, int opcode, unsigned char* bytes, int size);
+void startListingWriter(listingWriter* writer, FILE* file, void (*format)(FILE*, int, segment*, int, unsigned char*, int), bool threaded);
+void stopListingWriter(listingWriter* writer);